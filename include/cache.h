@@ -28,11 +28,15 @@ class cache {
 		std::vector<std::string> get_feed_urls();
 		void fetch_lastmodified(const std::string& uri, time_t& t, std::string& etag);
 		void update_lastmodified(const std::string& uri, time_t t, const std::string& etag);
+		void fetch_failure_state(const std::string& uri, unsigned int& failures, time_t& next_retry);
+		void update_failure_state(const std::string& uri, unsigned int failures, time_t next_retry);
 		unsigned int get_unread_count();
 		void mark_item_deleted(const std::string& guid, bool b);
 		void remove_old_deleted_items(const std::string& rssurl, const std::vector<std::string>& guids);
 		void mark_items_read_by_guid(const std::vector<std::string> guids);
 		std::vector<std::string> get_read_item_guids();
+		void begin_transaction();
+		void end_transaction();
 	private:
 		void populate_tables();
 		void set_pragmas();
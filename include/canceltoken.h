@@ -0,0 +1,26 @@
+#ifndef NEWSBEUTER_CANCELTOKEN__H
+#define NEWSBEUTER_CANCELTOKEN__H
+
+#include <csignal>
+
+namespace newsbeuter {
+
+/*
+ * A cancel_token is shared between whoever wants to stop a long-running
+ * operation and the code that does the work, which polls it at convenient
+ * points. It only consists of a sig_atomic_t, so it can be set from a
+ * signal handler.
+ */
+class cancel_token {
+	public:
+		cancel_token() : cancelled(0) { }
+		inline void cancel() { cancelled = 1; }
+		inline void reset() { cancelled = 0; }
+		inline bool is_cancelled() const { return cancelled != 0; }
+	private:
+		volatile sig_atomic_t cancelled;
+};
+
+}
+
+#endif
@@ -9,14 +9,18 @@
 #include <colormanager.h>
 #include <regexmanager.h>
 #include <remote_api.h>
+#include <failuretracker.h>
+#include <canceltoken.h>
 #include <libxml/tree.h>
 
 namespace newsbeuter {
 
 	extern int ctrl_c_hit;
+	extern cancel_token reload_cancel;
 	extern std::string lock_file;
 
 	class view;
+	class reload_pipeline;
 
 	class controller {
 		public:
@@ -30,8 +34,9 @@ namespace newsbeuter {
 
 			void reload_all(bool unattended = false);
 			void reload_indexes(const std::vector<int>& indexes, bool unattended = false);
-			void reload_range(unsigned int start, unsigned int end, unsigned int size, bool unattended = false);
 			void start_reload_all_thread(std::vector<int> * indexes = 0);
+			void bump_reload_priority(unsigned int pos);
+			void cancel_reload();
 
 			std::tr1::shared_ptr<rss_feed> get_feed(unsigned int pos);
 			std::tr1::shared_ptr<rss_feed> get_feed_by_url(const std::string& feedurl);
@@ -82,6 +87,8 @@ namespace newsbeuter {
 
 			void update_flags(std::tr1::shared_ptr<rss_item> item);
 		private:
+			friend class reload_pipeline;
+
 			void usage(char * argv0);
 			void version_information(const char * argv0, unsigned int level);
 			void import_opml(const char * filename);
@@ -103,6 +110,7 @@ namespace newsbeuter {
 			view * v;
 			urlreader * urlcfg;
 			cache * rsscache;
+			failure_tracker * reload_failures;
 			std::vector<std::tr1::shared_ptr<rss_feed> > feeds;
 			std::string config_dir;
 			std::string url_file;
@@ -115,6 +123,9 @@ namespace newsbeuter {
 			filtercontainer filters;
 
 			mutex reload_mutex;
+			mutex reload_prio_mtx;
+			std::string focused_feed;
+			reload_pipeline * active_pipeline;
 			configparser cfgparser;
 			colormanager colorman;
 			regexmanager rxman;
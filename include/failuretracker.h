@@ -0,0 +1,48 @@
+#ifndef NEWSBEUTER_FAILURETRACKER__H
+#define NEWSBEUTER_FAILURETRACKER__H
+
+#include <cache.h>
+#include <mutex.h>
+
+#include <curl/curl.h>
+
+#include <map>
+#include <string>
+
+namespace newsbeuter {
+
+class failure_tracker {
+	public:
+		failure_tracker(cache * c);
+		virtual ~failure_tracker();
+		bool may_reload(const std::string& rssurl);
+		void record_success(const std::string& rssurl);
+		// host_down means that the host couldn't be reached at all (see
+		// is_host_error()), as opposed to e.g. an HTTP error or a broken feed
+		void record_failure(const std::string& rssurl, bool host_down);
+		// must be called for every feed that may_reload() let through but
+		// whose reload was given up without a result (e.g. when cancelled)
+		void record_dropped(const std::string& rssurl);
+		static time_t backoff_delay(unsigned int failures, time_t base, time_t max);
+		static bool is_host_error(CURLcode code);
+	protected:
+		virtual time_t current_time();
+	private:
+		struct host_state {
+			host_state() : failures(0), trips(0), open_until(0) { }
+			unsigned int failures;
+			unsigned int trips;
+			time_t open_until; // 0 while the circuit is closed
+			std::string probe; // the feed that is reloaded as a probe, if any
+		};
+		std::string get_host(const std::string& rssurl);
+		void trip(host_state& hs, const std::string& host);
+
+		cache * ch;
+		std::map<std::string, host_state> hosts;
+		mutex mtx;
+};
+
+}
+
+#endif
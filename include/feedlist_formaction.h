@@ -22,6 +22,7 @@ class feedlist_formaction : public formaction {
 		void set_tags(const std::vector<std::string>& t);
 		virtual keymap_hint_entry * get_keymap_hint();
 		std::tr1::shared_ptr<rss_feed> get_feed();
+		std::vector<unsigned int> get_visible_positions();
 
 		virtual void set_redraw(bool b) { 
 			formaction::set_redraw(b); 
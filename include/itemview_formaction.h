@@ -41,6 +41,8 @@ class itemview_formaction : public formaction {
 		void render_source(std::vector<std::string>& lines, std::string desc, unsigned int width);
 
 		void do_search();
+
+		std::tr1::shared_ptr<rss_item> get_item();
 		
 		std::string guid;
 		std::tr1::shared_ptr<rss_feed> feed;
@@ -76,6 +76,7 @@ namespace newsbeuter {
 						OP_RANDOMUNREAD,
 						OP_SORT,
 						OP_REVSORT,
+						OP_CANCELRELOAD,
 						OP_NB_MAX,
 
 						// podbeuter-specific operations:
@@ -0,0 +1,39 @@
+#ifndef NEWSBEUTER_LITERALSCANNER__H
+#define NEWSBEUTER_LITERALSCANNER__H
+
+#include <string>
+#include <vector>
+
+namespace newsbeuter {
+
+	/*
+	 * Finds out in a single pass over a text which of a set of literal
+	 * strings it contains (ignoring the case of ASCII letters). The
+	 * literals are compiled into a deterministic automaton (Aho-Corasick),
+	 * so the cost of a scan doesn't depend on the number of literals.
+	 */
+	class literal_scanner {
+		public:
+			literal_scanner();
+			// empty literals are never found
+			void build(const std::vector<std::string>& literals);
+			// sets found[i] to true for every literal i that text contains
+			void scan(const std::string& text, std::vector<bool>& found) const;
+
+			// returns the longest literal string (in lower case) that every
+			// match of the extended regular expression rx contains, or an
+			// empty string if there is none or rx is too complicated.
+			static std::string required_literal(const std::string& rx);
+
+			static inline char to_lower(char c) { return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c; }
+		private:
+			unsigned int classes; // number of character classes
+			unsigned char char_class[256]; // 0 for characters that don't occur in any literal
+			std::vector<unsigned int> transitions; // state * classes + class -> next state
+			std::vector<std::vector<unsigned int> > outputs; // literals that end in a state
+			unsigned int literal_count;
+	};
+
+}
+
+#endif
@@ -3,38 +3,125 @@
 
 #include <FilterParser.h>
 
+#include <vector>
+#include <ctime>
+#include <tr1/memory>
+#include <tr1/unordered_set>
+
 namespace newsbeuter {
 
+	enum attribute_id {
+		ATTR_UNKNOWN = 0,
+		// rss_item attributes
+		ATTR_TITLE, ATTR_LINK, ATTR_AUTHOR, ATTR_CONTENT, ATTR_DATE, ATTR_GUID, ATTR_UNREAD, ATTR_ENCLOSURE_URL,
+		ATTR_ENCLOSURE_TYPE, ATTR_FLAGS, ATTR_AGE, ATTR_ARTICLEINDEX,
+		// rss_feed attributes
+		ATTR_FEEDTITLE, ATTR_DESCRIPTION, ATTR_FEEDLINK, ATTR_FEEDDATE, ATTR_RSSURL, ATTR_UNREAD_COUNT, ATTR_TOTAL_COUNT,
+		ATTR_TAGS, ATTR_FEEDINDEX
+	};
+
 	class matchable {
 		public:
 			matchable();
 			virtual ~matchable();
 			virtual bool has_attribute(const std::string& attribname) = 0;
 			virtual std::string get_attribute(const std::string& attribname) = 0;
+
+			// the same lookups with the attribute name already resolved by
+			// get_attribute_id(). The default implementations forward to the
+			// name-based methods, so only classes that care about speed need
+			// to implement them.
+			virtual bool has_attribute(attribute_id id, const std::string& attribname);
+			virtual std::string get_attribute(attribute_id id, const std::string& attribname);
+
+			// typed accessors, so that numbers and dates don't need to be
+			// formatted and parsed again, and stored strings don't need to be
+			// copied. get_attribute_ref() returns either a reference to the
+			// stored value or to buf, which it fills in. The defaults are
+			// implemented with get_attribute(); get_attribute_time() returns
+			// 0 if the attribute is no date.
+			virtual long get_attribute_int(attribute_id id, const std::string& attribname);
+			virtual time_t get_attribute_time(attribute_id id, const std::string& attribname);
+			virtual const std::string& get_attribute_ref(attribute_id id, const std::string& attribname, std::string& buf);
+			// the words (separated by spaces) of the attribute, if the
+			// matchable keeps them in a set for the "#" operator. The
+			// default returns NULL, and "#" searches get_attribute_ref().
+			virtual const std::tr1::unordered_set<std::string> * get_attribute_words(attribute_id id, const std::string& attribname);
+
+			// changes whenever any attribute changes, and never has the same
+			// value for two objects, so that the matcher can reuse earlier
+			// results for the same object. 0 (the default) means unknown.
+			virtual unsigned long attribute_generation();
+
+			static attribute_id get_attribute_id(const std::string& attribname);
+	};
+
+	/*
+	 * A filter expression is compiled into a flat program: every leaf of the
+	 * parse tree becomes one instruction that sets the result register, and
+	 * every "and"/"or" becomes a conditional jump that skips its right-hand
+	 * side, so evaluation is a simple loop with short-circuit semantics.
+	 */
+	struct matcher_instruction {
+		matcher_instruction() : op(0), id(ATTR_UNKNOWN), ilit(0), ilit2(0), has_range(false), rx_pivot(0), jump(0) { }
+
+		int op;
+		attribute_id id;
+		std::string name;
+		std::string literal;
+		int ilit, ilit2; // pre-parsed numeric literal, or range for MATCHOP_BETWEEN
+		bool has_range;
+		std::tr1::shared_ptr<regex_t> regex;
+		std::string regex_error;
+		std::string rx_literal; // lower case string that every match of regex contains, if any
+		unsigned int rx_pivot; // position of the character in rx_literal that is searched for first
+		unsigned int jump; // target of LOGOP_AND/LOGOP_OR
 	};
 
+	struct matcher_memo;
+
 	class matcher {
 		public:
 			matcher();
 			matcher(const std::string& expr);
 			bool parse(const std::string& expr);
 			bool matches(matchable* item);
+			// matches all items, in parallel if there are enough of them, and
+			// sets result[i] to 1 for every item that matches. If matching fails,
+			// the exception for the first item that failed is thrown.
+			void matches_all(const std::vector<matchable *>& items, std::vector<char>& result);
 			const std::string& get_parse_error();
 			const std::string& get_expression();
+			bool uses_attribute(attribute_id id) const;
 		private:
-			bool matches_r(expression * e, matchable * item);
+			void compile();
+			bool can_reorder(matchable * item);
+			bool evaluate(matchable * item);
+			bool run(const std::vector<matcher_instruction>& prog, matchable * item);
 
-			bool matchop_lt(expression * e, matchable * item);
-			bool matchop_gt(expression * e, matchable * item);
-			bool matchop_rxeq(expression * e, matchable * item);
-			bool matchop_cont(expression * e, matchable * item);
-			bool matchop_eq(expression * e, matchable * item);
-			bool matchop_between(expression * e, matchable * item);
+			bool matchop_lt(const matcher_instruction& in, matchable * item);
+			bool matchop_gt(const matcher_instruction& in, matchable * item);
+			bool matchop_rxeq(const matcher_instruction& in, matchable * item);
+			bool matchop_cont(const matcher_instruction& in, matchable * item);
+			bool matchop_eq(const matcher_instruction& in, matchable * item);
+			bool matchop_between(const matcher_instruction& in, matchable * item);
 
 			FilterParser p;
+			std::vector<matcher_instruction> program;
+			// the same expression with the operands of "and" and "or" ordered
+			// by estimated cost. It may only be run for items that have all
+			// attributes in checked_attributes, as only then none of the
+			// instructions can fail (which would depend on the order).
+			std::vector<matcher_instruction> optimized;
+			std::vector<std::pair<attribute_id, std::string> > checked_attributes;
+			// results of earlier matches by attribute_generation(), NULL if the
+			// results can change without the items changing (e.g. "age")
+			std::tr1::shared_ptr<matcher_memo> memo;
 			bool success;
 			std::string errmsg;
 			std::string exp;
+
+		friend struct match_job;
 	};
 
 }
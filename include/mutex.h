@@ -20,6 +20,17 @@ class mutex {
 	friend class condition;
 };
 
+class condition {
+	public:
+		condition();
+		~condition();
+		void wait(mutex * m);
+		void signal();
+		void broadcast();
+	private:
+		pthread_cond_t cond;
+};
+
 class scope_mutex {
 	public:
 		scope_mutex(mutex * m);
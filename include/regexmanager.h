@@ -6,6 +6,7 @@
 #include <sys/types.h>
 #include <regex.h>
 #include <matcher.h>
+#include <literalscanner.h>
 #include <utility>
 #include <tr1/memory>
 
@@ -25,6 +26,15 @@ class regexmanager : public config_action_handler {
 		std::map<std::string, rc_pair> locations;
 		std::vector<std::string> cheat_store_for_dump_config;
 		std::vector<std::pair<std::tr1::shared_ptr<matcher>, int> > matchers;
+		// the literal strings that the regular expressions of a location require
+		struct literal_index {
+			literal_index() : dirty(false) { }
+			std::vector<std::string> required; // one per regex, empty if there is none
+			literal_scanner scanner;
+			bool dirty; // scanner needs to be rebuilt from required
+		};
+		std::map<std::string, literal_index> literals;
+		void add_regex(const std::string& location, regex_t * rx, const std::string& pattern, const std::string& colorstr);
 		std::string extract_initial_marker(const std::string& str);
 	public:
 		inline std::vector<std::string>& get_attrs(const std::string& loc) { return locations[loc].second; }
@@ -0,0 +1,112 @@
+#ifndef NEWSBEUTER_RELOADPIPELINE__H
+#define NEWSBEUTER_RELOADPIPELINE__H
+
+#include <thread.h>
+#include <mutex.h>
+#include <rss.h>
+#include <rss_parser.h>
+#include <failuretracker.h>
+#include <utils.h>
+
+#include <deque>
+#include <vector>
+#include <string>
+
+namespace newsbeuter {
+
+class controller;
+
+enum reload_priority { RELOAD_PRIO_FOCUSED = 0, RELOAD_PRIO_VISIBLE, RELOAD_PRIO_UNREAD, RELOAD_PRIO_OTHER, RELOAD_PRIO_MAX };
+
+enum fetch_pool { FETCH_POOL_NETWORK = 0, FETCH_POOL_PLUGIN, FETCH_POOL_MAX };
+
+struct reload_job {
+	reload_job(unsigned int p, const std::string& url, rss_parser * rp, failure_tracker * ft)
+		: timer("reload_job " + url, LOG_INFO), pos(p), rssurl(url), parser(rp), host_down(false), tracker(ft), recorded(false) { }
+	// a job that is thrown away before its result was recorded mustn't keep
+	// its host's circuit waiting for a probe result forever
+	~reload_job() { if (!recorded) tracker->record_dropped(rssurl); delete parser; }
+	scope_measure timer; // logs the feed's latency from fetch to persist (used by make bench-reload)
+	unsigned int pos;
+	std::string rssurl;
+	rss_parser * parser;
+	std::tr1::shared_ptr<rss_feed> feed;
+	std::string errmsg;
+	bool host_down;
+	failure_tracker * tracker;
+	bool recorded;
+};
+
+class reload_queue {
+	public:
+		reload_queue(unsigned int capacity);
+		~reload_queue();
+		void push(reload_job * job);
+		reload_job * pop();
+		bool pop_all(std::vector<reload_job *>& batch);
+		void close();
+	private:
+		std::deque<reload_job *> jobs;
+		unsigned int cap;
+		bool closed;
+		mutex mtx;
+		condition not_empty;
+		condition not_full;
+};
+
+class reload_pipeline {
+	public:
+		reload_pipeline(controller * c, const std::vector<int>& indexes, bool unattended);
+		~reload_pipeline();
+		void run();
+		void bump(unsigned int pos);
+		// number of feeds that were skipped because they're backing off
+		inline unsigned int get_skipped() const { return skipped; }
+
+		void fetch_loop(fetch_pool pool);
+		void parse_loop();
+	private:
+		bool next_index(fetch_pool pool, unsigned int& pos);
+		fetch_pool get_pool(unsigned int pos);
+		void stage_finished(unsigned int& running, reload_queue& next_stage);
+		void persist_batch(std::vector<reload_job *>& batch);
+		std::string error_message(reload_job * job, const char * what);
+		void count_skipped();
+
+		controller * ctrl;
+		unsigned int count;
+		std::deque<unsigned int> pending[FETCH_POOL_MAX][RELOAD_PRIO_MAX];
+		std::vector<bool> scheduled;
+		bool u;
+		unsigned int fetch_threads[FETCH_POOL_MAX];
+		unsigned int parse_threads;
+		unsigned int fetchers_running;
+		unsigned int parsers_running;
+		unsigned int skipped;
+		mutex mtx;
+		reload_queue parse_queue;
+		reload_queue persist_queue;
+};
+
+class reload_fetchthread : public thread {
+	public:
+		reload_fetchthread(reload_pipeline * p, fetch_pool fp) : pipeline(p), pool(fp) { }
+	protected:
+		virtual void run();
+	private:
+		reload_pipeline * pipeline;
+		fetch_pool pool;
+};
+
+class reload_parsethread : public thread {
+	public:
+		reload_parsethread(reload_pipeline * p) : pipeline(p) { }
+	protected:
+		virtual void run();
+	private:
+		reload_pipeline * pipeline;
+};
+
+}
+
+#endif
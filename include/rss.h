@@ -10,6 +10,8 @@
 #include <utils.h>
 
 #include <tr1/memory>
+#include <tr1/unordered_map>
+#include <tr1/unordered_set>
 
 namespace newsbeuter {
 
@@ -23,20 +25,24 @@ namespace newsbeuter {
 			rss_item(cache * c);
 			~rss_item();
 			
-			std::string title() const;
-			std::string title_raw() const { return title_; }
+			inline const std::string& title() const { return title_display_; }
+			inline const std::string& title_raw() const { return title_; }
+			inline const std::string& title_sortkey() const { return title_sortkey_; }
 			void set_title(const std::string& t);
+			void take_title(std::string& t);
 			
 			inline const std::string& link() const { return link_; }
 			void set_link(const std::string& l);
 			
-			std::string author() const;
-			std::string author_raw() const { return author_; }
+			inline const std::string& author() const { return author_display_; }
+			inline const std::string& author_raw() const { return author_; }
 			void set_author(const std::string& a);
+			void take_author(std::string& a);
 		 	
 			std::string description() const;
-			std::string description_raw() const { return description_; }
+			inline const std::string& description_raw() const { return description_; }
 			void set_description(const std::string& d);
+			void take_description(std::string& d);
 			
 			std::string length() const;
 			std::string pubDate() const;
@@ -50,6 +56,7 @@ namespace newsbeuter {
 			
 			inline const std::string& guid() const { return guid_; }
 			void set_guid(const std::string& g);
+			void take_guid(std::string& g);
 			
 			inline bool unread() const { return unread_; }
 			void set_unread(bool u);
@@ -78,27 +85,46 @@ namespace newsbeuter {
 
 			virtual bool has_attribute(const std::string& attribname);
 			virtual std::string get_attribute(const std::string& attribname);
+			virtual bool has_attribute(attribute_id id, const std::string& attribname);
+			virtual std::string get_attribute(attribute_id id, const std::string& attribname);
+			virtual long get_attribute_int(attribute_id id, const std::string& attribname);
+			virtual time_t get_attribute_time(attribute_id id, const std::string& attribname);
+			virtual const std::string& get_attribute_ref(attribute_id id, const std::string& attribname, std::string& buf);
+			virtual const std::tr1::unordered_set<std::string> * get_attribute_words(attribute_id id, const std::string& attribname);
+			virtual unsigned long attribute_generation();
 
 			void set_feedptr(std::tr1::shared_ptr<rss_feed> ptr);
 			inline std::tr1::shared_ptr<rss_feed> get_feedptr() { return feedptr; }
 
 			inline bool deleted() const { return deleted_; }
-			inline void set_deleted(bool b) { deleted_ = b; }
+			void set_deleted(bool b);
 
-			inline void set_index(unsigned int i) { idx = i; }
+			inline void set_index(unsigned int i) { if (idx != i) { idx = i; touch(); } }
 			inline unsigned int get_index() { return idx; }
 
 			inline void set_base(const std::string& b) { base = b; }
+			inline void take_base(std::string& b) { base.swap(b); }
 			inline const std::string& get_base() { return base; }
 
 			inline void set_override_unread(bool b) { override_unread_ = b; }
 			inline bool override_unread() { return override_unread_; }
 
 		private:
+			rss_item(const rss_item&);
+			rss_item& operator=(const rss_item&);
+
+			void update_title_display();
+			void update_author_display();
+			void set_unread_state(bool u);
+			void touch();
+
 			std::string title_;
 			std::string link_;
 			std::string author_;
 			std::string description_;
+			std::string title_display_;
+			std::string title_sortkey_;
+			std::string author_display_;
 			time_t pubDate_;
 			std::string guid_;
 			std::string feedurl_;
@@ -114,6 +140,12 @@ namespace newsbeuter {
 			unsigned int idx;
 			std::string base;
 			bool override_unread_;
+			std::vector<rss_feed *> counting_feeds; // the feeds whose unread counter includes this item
+			unsigned long generation_;
+
+			void touch_feeds();
+
+		friend class rss_feed;
 	};
 
 	class rss_feed : public matchable {
@@ -123,26 +155,55 @@ namespace newsbeuter {
 			~rss_feed();
 			std::string title_raw() const { return title_; }
 			std::string title() const;
-			inline void set_title(const std::string& t) { title_ = t; utils::trim(title_); }
+			inline void set_title(const std::string& t) { title_ = t; utils::trim(title_); touch(); }
 			
 			std::string description_raw() const { return description_; }
 			std::string description() const;
-			inline void set_description(const std::string& d) { description_ = d; }
+			inline void set_description(const std::string& d) { description_ = d; touch(); }
 			
 			inline const std::string& link() const { return link_; }
-			inline void set_link(const std::string& l) { link_ = l; }
+			inline void set_link(const std::string& l) { link_ = l; touch(); }
 			
 			inline std::string pubDate() const { return "TODO"; }
-			inline void set_pubDate(time_t t) { pubDate_ = t; }
+			inline void set_pubDate(time_t t) { pubDate_ = t; touch(); }
 			
+			// items() may be used to read and reorder the items; adding and
+			// removing items must go through the functions below, as they
+			// keep the guid index up to date.
 			inline std::vector<std::tr1::shared_ptr<rss_item> >& items() { return items_; }
+			void add_item(std::tr1::shared_ptr<rss_item> item);
+			void set_items(const std::vector<std::tr1::shared_ptr<rss_item> >& items);
+			void clear_items();
+			std::vector<std::tr1::shared_ptr<rss_item> >::iterator erase_item(std::vector<std::tr1::shared_ptr<rss_item> >::iterator it);
+			void erase_items(std::vector<std::tr1::shared_ptr<rss_item> >::iterator begin, std::vector<std::tr1::shared_ptr<rss_item> >::iterator end);
+
+			// removes all items for which pred returns true in a single pass,
+			// keeping the order of the remaining items. pred is called once
+			// for every item, in order. Returns the removed items.
+			template <typename Predicate>
+			std::vector<std::tr1::shared_ptr<rss_item> > remove_items_if(Predicate pred) {
+				std::vector<std::tr1::shared_ptr<rss_item> > removed;
+				std::vector<std::tr1::shared_ptr<rss_item> >::iterator out = items_.begin();
+				for (std::vector<std::tr1::shared_ptr<rss_item> >::iterator it=items_.begin();it!=items_.end();++it) {
+					if (pred(*it)) {
+						removed.push_back(*it);
+					} else {
+						if (out != it)
+							out->swap(*it);
+						++out;
+					}
+				}
+				finish_removal(removed, out);
+				return removed;
+			}
 
+			// returns an empty pointer if there is no item with that guid.
 			std::tr1::shared_ptr<rss_item> get_item_by_guid(const std::string& guid);
 			
 			inline const std::string& rssurl() const { return rssurl_; }
 			void set_rssurl(const std::string& u);
 			
-			unsigned int unread_item_count();
+			inline unsigned int unread_item_count() const { return unread_count_; }
 			inline unsigned int total_item_count() const { return items_.size(); }
 
 			void set_tags(const std::vector<std::string>& tags);
@@ -152,9 +213,23 @@ namespace newsbeuter {
 
 			virtual bool has_attribute(const std::string& attribname);
 			virtual std::string get_attribute(const std::string& attribname);
-
+			virtual bool has_attribute(attribute_id id, const std::string& attribname);
+			virtual std::string get_attribute(attribute_id id, const std::string& attribname);
+			virtual long get_attribute_int(attribute_id id, const std::string& attribname);
+			virtual time_t get_attribute_time(attribute_id id, const std::string& attribname);
+			virtual const std::string& get_attribute_ref(attribute_id id, const std::string& attribname, std::string& buf);
+			virtual const std::tr1::unordered_set<std::string> * get_attribute_words(attribute_id id, const std::string& attribname);
+			virtual unsigned long attribute_generation();
+
+			// (re)fills a query feed. Only the items of feeds that changed since
+			// the last call are matched again.
 			void update_items(std::vector<std::tr1::shared_ptr<rss_feed> >& feeds);
 
+			// changes whenever items are added or removed, an item changes in
+			// a way that may affect query feeds, or an attribute of the feed
+			// changes. Generations are unique across all feeds and items.
+			unsigned long generation();
+
 			inline void set_query(const std::string& s) { query = s; }
 
 			bool is_empty() { return empty; }
@@ -170,7 +245,7 @@ namespace newsbeuter {
 			inline void set_rtl(bool b) { is_rtl_ = b; }
 			inline bool is_rtl() { return is_rtl_; }
 
-			inline void set_index(unsigned int i) { idx = i; }
+			inline void set_index(unsigned int i) { if (idx != i) { idx = i; touch(); } }
 			inline unsigned int get_index() { return idx; }
 
 			inline void set_order(unsigned int x) { order = x; }
@@ -178,6 +253,16 @@ namespace newsbeuter {
 
 			void set_feedptrs(std::tr1::shared_ptr<rss_feed> self);
 
+		private:
+			void count_item(std::tr1::shared_ptr<rss_item> item);
+			void uncount_items(std::vector<std::tr1::shared_ptr<rss_item> >::iterator begin, std::vector<std::tr1::shared_ptr<rss_item> >::iterator end);
+			void finish_removal(std::vector<std::tr1::shared_ptr<rss_item> >& removed, std::vector<std::tr1::shared_ptr<rss_item> >::iterator end);
+			void rebuild_guid_map();
+			void merge_items(std::vector<std::tr1::shared_ptr<rss_item> >& items);
+			void touch();
+
+		public:
+
 			mutex item_mutex; // this is ugly, but makes it possible to lock items use e.g. from the cache class
 		private:
 			std::string title_;
@@ -186,8 +271,14 @@ namespace newsbeuter {
 			time_t pubDate_;
 			std::string rssurl_;
 			std::vector<std::tr1::shared_ptr<rss_item> > items_;
+			std::tr1::unordered_map<std::string, std::tr1::shared_ptr<rss_item> > items_guid_map;
+			unsigned int unread_count_;
 			std::vector<std::string> tags_;
+			std::tr1::unordered_set<std::string> tag_words; // the words of get_tags(), for "tags # ..."
 			std::string query;
+			std::tr1::shared_ptr<matcher> query_matcher;
+			std::tr1::unordered_map<rss_feed *, unsigned long> query_sources; // generation of every feed the last update_items() saw
+			std::string sorted_by; // sort method items_ is ordered by, if any
 			
 			cache * ch;
 
@@ -195,6 +286,9 @@ namespace newsbeuter {
 			bool is_rtl_;
 			unsigned int idx;
 			unsigned int order;
+			unsigned long generation_;
+
+		friend class rss_item;
 	};
 
 	class rss_ignores : public config_action_handler {
@@ -208,6 +302,10 @@ namespace newsbeuter {
 			bool matches_resetunread(const std::string& url);
 		private:
 			std::vector<feedurl_expr_pair> ignores;
+			// positions in ignores of the rules for each feed URL and of the
+			// rules for all feeds ("*"), in ascending order
+			std::tr1::unordered_map<std::string, std::vector<unsigned int> > ignores_by_url;
+			std::vector<unsigned int> wildcard_ignores;
 			std::vector<std::string> ignores_lastmodified;
 			std::vector<std::string> resetflag;
 	};
@@ -6,6 +6,8 @@
 #include <rss.h>
 #include <rsspp.h>
 #include <remote_api.h>
+#include <canceltoken.h>
+#include <utils.h>
 
 namespace newsbeuter {
 
@@ -17,6 +19,12 @@ namespace newsbeuter {
 			rss_parser(const char * uri, cache * c, configcontainer *, rss_ignores * ii, remote_api * a = 0);
 			~rss_parser();
 			std::tr1::shared_ptr<rss_feed> parse();
+
+			void fetch();
+			std::tr1::shared_ptr<rss_feed> build_feed();
+			void commit(std::tr1::shared_ptr<rss_feed> feed);
+			inline void set_cancel_token(cancel_token * t) { cancel = t; }
+
 			bool check_and_update_lastmodified();
 		private:
 			void replace_newline_characters(std::string& str);
@@ -30,7 +38,9 @@ namespace newsbeuter {
 			void download_http(const std::string& uri);
 			void get_execplugin(const std::string& plugin);
 			void download_filterplugin(const std::string& filter, const std::string& uri);
-			void parse_file(const std::string& file);
+			void check_cancelled();
+			void check_plugin_killed(bool killed);
+			void parse_buffer();
 
 			void fill_feed_fields(std::tr1::shared_ptr<rss_feed> feed);
 			void fill_feed_items(std::tr1::shared_ptr<rss_feed> feed);
@@ -39,7 +49,7 @@ namespace newsbeuter {
 			void set_item_author(std::tr1::shared_ptr<rss_item> x, rsspp::item& item);
 			void set_item_content(std::tr1::shared_ptr<rss_item> x, rsspp::item& item);
 			void set_item_enclosure(std::tr1::shared_ptr<rss_item> x, rsspp::item& item);
-			std::string get_guid(rsspp::item& item);
+			void set_item_guid(std::tr1::shared_ptr<rss_item> x, rsspp::item& item);
 
 			void add_item_to_feed(std::tr1::shared_ptr<rss_feed> feed, std::tr1::shared_ptr<rss_item> item);
 
@@ -52,9 +62,18 @@ namespace newsbeuter {
 			configcontainer *cfgcont;
 			bool skip_parsing;
 			bool is_valid;
+			bool fetched;
 			rss_ignores * ign;
 			rsspp::feed f;
 			remote_api * api;
+
+			std::string buf;
+			std::string filename;
+			bool update_lm;
+			time_t new_lm;
+			std::string new_etag;
+			cancel_token * cancel;
+			date_memo parsed_dates;
 	};
 
 }
@@ -5,6 +5,7 @@
 #include <string>
 
 #include <logger.h>
+#include <canceltoken.h>
 #include <curl/curl.h>
 #include <configcontainer.h>
 #include <libxml/parser.h>
@@ -27,9 +28,12 @@ class utils {
 
 		static std::string get_command_output(const std::string& cmd);
 		static void extract_filter(const std::string& line, std::string& filter, std::string& url);
-		static std::string retrieve_url(const std::string& url, configcontainer * cfgcont = NULL, const char * authinfo = NULL);
+		static std::string retrieve_url(const std::string& url, configcontainer * cfgcont = NULL, const char * authinfo = NULL, cancel_token * cancel = NULL);
 		static void run_command(const std::string& cmd, const std::string& param); // used for notifications only
-		static std::string run_program(char * argv[], const std::string& input);
+		// the program is killed when the timeout expires or cancel is cancelled, which is reported through killed
+		static std::string run_program(char * argv[], const std::string& input, unsigned int timeout = 0, cancel_token * cancel = NULL, bool * killed = NULL);
+		// makes the transfer abort with CURLE_ABORTED_BY_CALLBACK once cancel is cancelled
+		static void set_curl_cancel_token(CURL * handle, cancel_token * cancel);
 
 		static std::string resolve_tilde(const std::string& );
 		static std::string replace_all(std::string str, const std::string& from, const std::string& to);
@@ -88,11 +92,31 @@ class utils {
 		static std::string escape_url(const std::string& url);
 		static std::string unescape_url(const std::string& url);
 
+		static bool parse_date(const std::string& datestr, time_t& t);
+
 	private:
 		static void append_escapes(std::string& str, char c);
 
 };
 
+/*
+ * date_memo remembers the last few date strings of a feed and their parsed
+ * values. Dates repeat mostly in runs (items published together, or the
+ * feed's own date), so a handful of entries catch nearly all repetitions,
+ * and a lookup is cheaper than even the fast path of utils::parse_date.
+ */
+class date_memo {
+	public:
+		date_memo();
+		bool lookup(const std::string& datestr, time_t& t);
+		void add(const std::string& datestr, time_t t);
+	private:
+		enum { SIZE = 4 };
+		std::string dates[SIZE];
+		time_t times[SIZE];
+		unsigned int next;
+};
+
 class scope_measure {
 	public:
 		scope_measure(const std::string& func, loglevel ll = LOG_DEBUG);
@@ -78,6 +78,7 @@ namespace newsbeuter {
 			void notify_itemlist_change(std::tr1::shared_ptr<rss_feed> feed);
 
 			void feedlist_mark_pos_if_visible(unsigned int pos);
+			std::vector<unsigned int> get_visible_feed_positions();
 
 			void set_regexmanager(regexmanager * r);
 
@@ -0,0 +1,55 @@
+#ifndef NEWSBEUTER_WORKERPOOL__H
+#define NEWSBEUTER_WORKERPOOL__H
+
+#include <thread.h>
+#include <mutex.h>
+
+#include <deque>
+#include <vector>
+
+namespace newsbeuter {
+
+	class worker_job {
+		public:
+			virtual ~worker_job() { }
+			virtual void run() = 0; // must not throw
+	};
+
+	struct worker_batch;
+
+	/*
+	 * A fixed set of threads (one less than there are CPUs) that runs
+	 * worker_jobs. run() hands a batch of jobs to the pool, works on them
+	 * in the calling thread as well and returns when all of them are
+	 * finished, so it can be used from several threads at once.
+	 */
+	class worker_pool {
+		public:
+			static worker_pool& get();
+
+			void run(std::vector<worker_job *>& jobs);
+			inline unsigned int concurrency() const { return workers + 1; }
+
+			void work_loop();
+		private:
+			worker_pool(unsigned int threads);
+			bool run_next_job();
+
+			unsigned int workers;
+			std::deque<std::pair<worker_job *, worker_batch *> > queue;
+			mutex mtx;
+			condition job_available;
+	};
+
+	class worker_thread : public thread {
+		public:
+			worker_thread(worker_pool * p) : pool(p) { }
+		protected:
+			virtual void run();
+		private:
+			worker_pool * pool;
+	};
+
+}
+
+#endif
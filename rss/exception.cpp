@@ -8,7 +8,7 @@
 
 namespace rsspp {
 
-exception::exception(const std::string& errmsg) : emsg(errmsg) { 
+exception::exception(const std::string& errmsg, CURLcode code) : emsg(errmsg), curlcode(code) { 
 }
 
 exception::~exception() throw() {
@@ -26,7 +26,7 @@ static size_t my_write_data(void *buffer, size_t size, size_t nmemb, void *userp
 namespace rsspp {
 
 parser::parser(unsigned int timeout, const char * user_agent, const char * proxy, const char * proxy_auth, curl_proxytype proxy_type) 
-	: to(timeout), ua(user_agent), prx(proxy), prxauth(proxy_auth), prxtype(proxy_type), doc(0), lm(0) {
+	: to(timeout), ua(user_agent), prx(proxy), prxauth(proxy_auth), prxtype(proxy_type), doc(0), lm(0), cancel(0), be(BACKEND_STREAM) {
 }
 
 parser::~parser() {
@@ -61,6 +61,17 @@ static size_t handle_headers(void * ptr, size_t size, size_t nmemb, void * data)
 }
 
 feed parser::parse_url(const std::string& url, time_t lastmodified, const std::string& etag, newsbeuter::remote_api * api) {
+	std::string buf = fetch_url(url, lastmodified, etag, api);
+
+	if (buf.length() > 0) {
+		LOG(LOG_DEBUG, "parser::parse_url: handing over data to parse_buffer()");
+		return parse_buffer(buf.c_str(), buf.length(), url.c_str());
+	}
+
+	return feed();
+}
+
+std::string parser::fetch_url(const std::string& url, time_t lastmodified, const std::string& etag, newsbeuter::remote_api * api) {
 	std::string buf;
 	CURLcode ret;
 
@@ -95,6 +106,8 @@ feed parser::parse_url(const std::string& url, time_t lastmodified, const std::s
 
 	curl_easy_setopt(easyhandle, CURLOPT_PROXYTYPE, prxtype);
 
+	utils::set_curl_cancel_token(easyhandle, cancel);
+
 	header_values hdrs = { 0, "" };
 
 	curl_slist * custom_headers = NULL;
@@ -121,7 +134,7 @@ feed parser::parse_url(const std::string& url, time_t lastmodified, const std::s
 		curl_slist_free_all(custom_headers);
 	}
 
-	LOG(LOG_DEBUG, "rsspp::parser::parse_url: ret = %d", ret);
+	LOG(LOG_DEBUG, "rsspp::parser::fetch_url: ret = %d", ret);
 
 	long status;
 	curl_easy_getinfo(easyhandle, CURLINFO_HTTP_CONNECTCODE, &status);
@@ -133,21 +146,24 @@ feed parser::parse_url(const std::string& url, time_t lastmodified, const std::s
 	curl_easy_cleanup(easyhandle);
 
 	if (ret != 0) {
-		LOG(LOG_ERROR, "rsspp::parser::parse_url: curl_easy_perform returned err %d: %s", ret, curl_easy_strerror(ret));
-		throw exception(curl_easy_strerror(ret));
+		LOG(LOG_ERROR, "rsspp::parser::fetch_url: curl_easy_perform returned err %d: %s", ret, curl_easy_strerror(ret));
+		throw exception(curl_easy_strerror(ret), ret);
 	}
 
-	LOG(LOG_INFO, "parser::parse_url: retrieved data for %s: %s", url.c_str(), buf.c_str());
+	LOG(LOG_INFO, "parser::fetch_url: retrieved data for %s: %s", url.c_str(), buf.c_str());
 
-	if (buf.length() > 0) {
-		LOG(LOG_DEBUG, "parser::parse_url: handing over data to parse_buffer()");
-		return parse_buffer(buf.c_str(), buf.length(), url.c_str());
-	}
-
-	return feed();
+	return buf;
 }
 
 feed parser::parse_buffer(const char * buffer, size_t size, const char * url) {
+	if (be == BACKEND_STREAM) {
+		feed f;
+		stream_parser sp(f);
+		sp.parse_memory(buffer, size, url);
+		LOG(LOG_INFO, "parser::parse_buffer: encoding = %s", f.encoding.c_str());
+		return f;
+	}
+
 	doc = xmlReadMemory(buffer, size, url, NULL, XML_PARSE_RECOVER | XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
 	if (doc == NULL) {
 		throw exception(_("could not parse buffer"));
@@ -167,6 +183,14 @@ feed parser::parse_buffer(const char * buffer, size_t size, const char * url) {
 }
 
 feed parser::parse_file(const std::string& filename) {
+	if (be == BACKEND_STREAM) {
+		feed f;
+		stream_parser sp(f);
+		sp.parse_file(filename);
+		LOG(LOG_INFO, "parser::parse_file: encoding = %s", f.encoding.c_str());
+		return f;
+	}
+
 	doc = xmlReadFile(filename.c_str(), NULL, XML_PARSE_RECOVER | XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
 	if (doc == NULL) {
 		throw exception(_("could not parse file"));
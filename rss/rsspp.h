@@ -12,11 +12,14 @@
 #include <libxml/parser.h>
 #include <curl/curl.h>
 #include <remote_api.h>
+#include <canceltoken.h>
 
 namespace rsspp {
 
 enum version { UNKNOWN = 0, RSS_0_91, RSS_0_92, RSS_1_0, RSS_2_0, ATOM_0_3, ATOM_1_0, RSS_0_94, ATOM_0_3_NONS };
 
+enum backend { BACKEND_STREAM = 0, BACKEND_DOM };
+
 struct item {
 	std::string title;
 	std::string title_type;
@@ -61,11 +64,14 @@ struct feed {
 
 class exception : public std::exception {
 	public:
-		exception(const std::string& errmsg = "");
+		exception(const std::string& errmsg = "", CURLcode code = CURLE_OK);
 		~exception() throw();
 		virtual const char* what() const throw();
+		// the libcurl error that made a download fail, CURLE_OK for all other errors
+		inline CURLcode curl_error() const { return curlcode; }
 	private:
 		std::string emsg;
+		CURLcode curlcode;
 };
 
 class parser {
@@ -73,10 +79,13 @@ class parser {
 		parser(unsigned int timeout = 30, const char * user_agent = 0, const char * proxy = 0, const char * proxy_auth = 0, curl_proxytype proxy_type = CURLPROXY_HTTP);
 		~parser();
 		feed parse_url(const std::string& url, time_t lastmodified = 0, const std::string& etag = "", newsbeuter::remote_api * api = 0);
+		std::string fetch_url(const std::string& url, time_t lastmodified = 0, const std::string& etag = "", newsbeuter::remote_api * api = 0);
 		feed parse_buffer(const char * buffer, size_t size, const char * url = NULL);
 		feed parse_file(const std::string& filename);
 		time_t get_last_modified() { return lm; }
 		const std::string& get_etag() { return et; }
+		inline void set_cancel_token(newsbeuter::cancel_token * t) { cancel = t; }
+		inline void set_backend(backend b) { be = b; }
 
 		static void global_init();
 		static void global_cleanup();
@@ -91,6 +100,8 @@ class parser {
 		xmlDocPtr doc;
 		time_t lm;
 		std::string et;
+		newsbeuter::cancel_token * cancel;
+		backend be;
 };
 
 }
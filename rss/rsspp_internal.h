@@ -64,6 +64,65 @@ struct atom_parser : public rss_parser {
 		const char * ns;
 };
 
+struct stream_parser {
+		stream_parser(feed& fd);
+		~stream_parser();
+		void parse_memory(const char * buffer, size_t size, const char * url);
+		void parse_file(const std::string& filename);
+	private:
+		enum { FORMAT_UNKNOWN, FORMAT_RSS, FORMAT_RDF, FORMAT_ATOM, FORMAT_OTHER };
+
+		void create_context(const char * url);
+		void finish(const char * errmsg);
+		void fail(const char * errmsg);
+		std::string attr(int nb_attributes, const xmlChar ** attributes, const char * name, bool any_ns = false);
+		void capture(std::string& out, int act = 0, bool xml = false);
+		void end_capture();
+
+		int start_root(const xmlChar * localname, const xmlChar * URI, int nb_attributes, const xmlChar ** attributes);
+		int start_rss_channel_child(const xmlChar * localname, const xmlChar * URI);
+		int start_rss_item_child(int parent, const xmlChar * localname, const xmlChar * URI, int nb_attributes, const xmlChar ** attributes);
+		int start_rdf_child(const xmlChar * localname, const xmlChar * URI, int nb_attributes, const xmlChar ** attributes);
+		int start_rdf_grandchild(int parent, const xmlChar * localname, const xmlChar * URI);
+		int start_atom_child(const xmlChar * localname, const xmlChar * URI, int nb_attributes, const xmlChar ** attributes);
+		int start_atom_entry_child(int parent, const xmlChar * localname, const xmlChar * URI, int nb_attributes, const xmlChar ** attributes);
+		int start_atom_text(std::string& out, std::string& type, int nb_attributes, const xmlChar ** attributes);
+
+		static stream_parser * get(void * ctx);
+		static bool is(const xmlChar * localname, const xmlChar * uri, const char * name, const char * ns_uri = NULL);
+		static void start_element(void * ctx, const xmlChar * localname, const xmlChar * prefix, const xmlChar * URI,
+				int nb_namespaces, const xmlChar ** namespaces, int nb_attributes, int nb_defaulted, const xmlChar ** attributes);
+		static void end_element(void * ctx, const xmlChar * localname, const xmlChar * prefix, const xmlChar * URI);
+		static void characters(void * ctx, const xmlChar * ch, int len);
+		static void cdata(void * ctx, const xmlChar * value, int len);
+		static void reference(void * ctx, const xmlChar * name);
+		static void comment(void * ctx, const xmlChar * value);
+		static void processing_instruction(void * ctx, const xmlChar * target, const xmlChar * data);
+
+		feed& f;
+		xmlSAXHandler handler;
+		xmlParserCtxtPtr ctxt;
+		std::string error;
+		int format;
+		std::vector<int> roles;
+		bool channel_seen;
+		const char * ns;
+		std::string globalbase;
+
+		std::string * target;
+		int capture_depth;
+		bool capture_xml;
+		xmlNodePtr capture_node;
+		int action;
+		std::string scratch;
+
+		std::string dc_creator;
+		std::string entry_summary;
+		std::string entry_summary_type;
+		std::string entry_updated;
+		std::string entry_base;
+};
+
 struct rss_parser_factory {
 	static std::tr1::shared_ptr<rss_parser> get_object(feed& f, xmlDocPtr doc);
 };
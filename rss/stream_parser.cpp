@@ -0,0 +1,649 @@
+/* rsspp - Copyright (C) 2008-2010 Andreas Krennmair <ak@newsbeuter.org>
+ * Licensed under the MIT/X Consortium License. See file LICENSE
+ * for more information.
+ */
+
+#include <config.h>
+#include <rsspp_internal.h>
+#include <utils.h>
+#include <libxml/parserInternals.h>
+#include <libxml/SAX2.h>
+#include <cstdio>
+#include <cstring>
+
+#define RSS_1_0_NS "http://purl.org/rss/1.0/"
+
+namespace rsspp {
+
+/*
+ * stream_parser is the SAX2-based counterpart of rss_09x_parser,
+ * rss_10_parser and atom_parser: instead of building a DOM first and walking
+ * it, it fills the feed and item fields directly from the parser callbacks.
+ * It must produce exactly the same results as the DOM-based parsers,
+ * including their quirks (e.g. that only the first RSS channel is read, or
+ * which attributes are matched with or without a namespace); test-rss runs
+ * its test cases against both backends.
+ *
+ * Every open element has a role that says how its children are handled. The
+ * text of an element that is read into a feed or item field is collected
+ * while it is open ("capture"). Inline XHTML in Atom content is the only
+ * case that needs markup rather than text; for that, the callbacks are
+ * forwarded to libxml2's own SAX2 tree builder for the duration of that
+ * element, and the resulting subtree is serialized like the DOM backend does.
+ *
+ * Exceptions must not be thrown through libxml2, so errors are recorded,
+ * the parser is stopped, and parse_memory()/parse_file() throw afterwards.
+ */
+
+enum { ROLE_IGNORE = 0, ROLE_CAPTURE, ROLE_RSS, ROLE_RSS_CHANNEL, ROLE_RSS_ITEM, ROLE_MEDIA_GROUP,
+	ROLE_RDF, ROLE_RDF_CHANNEL, ROLE_RDF_ITEM, ROLE_ATOM, ROLE_ATOM_ENTRY, ROLE_ATOM_AUTHOR };
+
+enum { ACTION_NONE = 0, ACTION_W3CDTF, ACTION_RSS_AUTHOR };
+
+stream_parser::stream_parser(feed& fd) : f(fd), ctxt(0), format(FORMAT_UNKNOWN), channel_seen(false),
+	ns(0), target(0), capture_depth(-1), capture_xml(false), capture_node(0), action(ACTION_NONE) {
+	memset(&handler, 0, sizeof(handler));
+	xmlSAXVersion(&handler, 2);
+	handler.startElementNs = start_element;
+	handler.endElementNs = end_element;
+	handler.characters = characters;
+	handler.ignorableWhitespace = characters;
+	handler.cdataBlock = cdata;
+	handler.reference = reference;
+	handler.comment = comment;
+	handler.processingInstruction = processing_instruction;
+}
+
+stream_parser::~stream_parser() {
+	if (ctxt) {
+		if (ctxt->myDoc)
+			xmlFreeDoc(ctxt->myDoc);
+		ctxt->myDoc = NULL;
+		xmlFreeParserCtxt(ctxt);
+	}
+}
+
+void stream_parser::create_context(const char * url) {
+	ctxt = xmlCreatePushParserCtxt(&handler, NULL, NULL, 0, url);
+	if (!ctxt)
+		throw exception(_("could not parse buffer"));
+	xmlCtxtUseOptions(ctxt, XML_PARSE_RECOVER | XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
+	ctxt->_private = this;
+}
+
+void stream_parser::parse_memory(const char * buffer, size_t size, const char * url) {
+	create_context(url);
+	xmlParseChunk(ctxt, buffer, size, 1);
+	finish(_("could not parse buffer"));
+}
+
+void stream_parser::parse_file(const std::string& filename) {
+	FILE * fp = fopen(filename.c_str(), "r");
+	if (!fp)
+		throw exception(_("could not parse file"));
+	try {
+		create_context(filename.c_str());
+	} catch (...) {
+		fclose(fp);
+		throw;
+	}
+	char buf[16384];
+	size_t len;
+	while (!ctxt->disableSAX && (len = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		xmlParseChunk(ctxt, buf, len, 0);
+	}
+	xmlParseChunk(ctxt, NULL, 0, 1);
+	fclose(fp);
+	finish(_("could not parse file"));
+}
+
+void stream_parser::finish(const char * errmsg) {
+	if (error != "")
+		throw exception(error);
+	if (format == FORMAT_UNKNOWN)
+		throw exception(errmsg);
+	if (format == FORMAT_RSS && !channel_seen)
+		throw exception(_("no RSS channel found"));
+
+	if (ctxt->myDoc && ctxt->myDoc->encoding) {
+		f.encoding = (const char *)ctxt->myDoc->encoding;
+	} else if (ctxt->encoding) {
+		f.encoding = (const char *)ctxt->encoding;
+	}
+}
+
+void stream_parser::fail(const char * errmsg) {
+	if (error == "")
+		error = errmsg;
+	xmlStopParser(ctxt);
+}
+
+stream_parser * stream_parser::get(void * ctx) {
+	xmlParserCtxtPtr c = static_cast<xmlParserCtxtPtr>(ctx);
+	stream_parser * sp = static_cast<stream_parser *>(c->_private);
+	// libxml2 parses the replacement text of entities with a separate
+	// context that inherits _private; those events are not part of the
+	// document and go to the tree builder, so that reference() finds the
+	// entity's content.
+	if (!sp || sp->ctxt != c)
+		return NULL;
+	return sp;
+}
+
+bool stream_parser::is(const xmlChar * localname, const xmlChar * uri, const char * name, const char * ns_uri) {
+	if (strcmp((const char *)localname, name)!=0)
+		return false;
+	if (!ns_uri)
+		return uri == NULL;
+	return uri && strcmp((const char *)uri, ns_uri)==0;
+}
+
+std::string stream_parser::attr(int nb_attributes, const xmlChar ** attributes, const char * name, bool any_ns) {
+	for (int i=0;i<nb_attributes;i++) {
+		const xmlChar ** a = attributes + i*5;
+		if (strcmp((const char *)a[0], name)!=0 || (!any_ns && a[2] != NULL))
+			continue;
+		const xmlChar * begin = a[3];
+		const xmlChar * end = a[4];
+		// without entity substitution, libxml2 leaves references in
+		// attribute values for the tree builder to resolve.
+		if (memchr(begin, '&', end - begin)) {
+			xmlChar * decoded = xmlStringLenDecodeEntities(ctxt, begin, end - begin, XML_SUBSTITUTE_REF, 0, 0, 0);
+			if (decoded) {
+				std::string result = (const char *)decoded;
+				xmlFree(decoded);
+				return result;
+			}
+		}
+		return std::string((const char *)begin, end - begin);
+	}
+	return "";
+}
+
+void stream_parser::capture(std::string& out, int act, bool xml) {
+	out.clear();
+	target = &out;
+	action = act;
+	capture_xml = xml;
+	capture_depth = roles.size();
+}
+
+void stream_parser::start_element(void * ctx, const xmlChar * localname, const xmlChar * prefix, const xmlChar * URI,
+		int nb_namespaces, const xmlChar ** namespaces, int nb_attributes, int nb_defaulted, const xmlChar ** attributes) {
+	stream_parser * sp = get(ctx);
+	if (!sp) {
+		xmlSAX2StartElementNs(ctx, localname, prefix, URI, nb_namespaces, namespaces, nb_attributes, nb_defaulted, attributes);
+		return;
+	}
+
+	if (sp->capture_depth >= 0) {
+		if (sp->capture_xml)
+			xmlSAX2StartElementNs(ctx, localname, prefix, URI, nb_namespaces, namespaces, nb_attributes, nb_defaulted, attributes);
+		sp->roles.push_back(ROLE_IGNORE);
+		return;
+	}
+
+	int parent = sp->roles.size() > 0 ? sp->roles.back() : -1;
+	int role = ROLE_IGNORE;
+
+	switch (parent) {
+		case -1:
+			role = sp->start_root(localname, URI, nb_attributes, attributes);
+			break;
+		case ROLE_RSS:
+			if (!sp->channel_seen && strcmp((const char *)localname, "channel")==0) {
+				sp->channel_seen = true;
+				role = ROLE_RSS_CHANNEL;
+			}
+			break;
+		case ROLE_RSS_CHANNEL:
+			role = sp->start_rss_channel_child(localname, URI);
+			break;
+		case ROLE_RSS_ITEM:
+		case ROLE_MEDIA_GROUP:
+			role = sp->start_rss_item_child(parent, localname, URI, nb_attributes, attributes);
+			break;
+		case ROLE_RDF:
+			role = sp->start_rdf_child(localname, URI, nb_attributes, attributes);
+			break;
+		case ROLE_RDF_CHANNEL:
+		case ROLE_RDF_ITEM:
+			role = sp->start_rdf_grandchild(parent, localname, URI);
+			break;
+		case ROLE_ATOM:
+			role = sp->start_atom_child(localname, URI, nb_attributes, attributes);
+			break;
+		case ROLE_ATOM_ENTRY:
+		case ROLE_ATOM_AUTHOR:
+			role = sp->start_atom_entry_child(parent, localname, URI, nb_attributes, attributes);
+			break;
+		default:
+			break;
+	}
+
+	if (role == ROLE_CAPTURE && sp->capture_xml) {
+		xmlSAX2StartElementNs(ctx, localname, prefix, URI, nb_namespaces, namespaces, nb_attributes, nb_defaulted, attributes);
+		sp->capture_node = sp->ctxt->node;
+	}
+
+	sp->roles.push_back(role);
+}
+
+int stream_parser::start_root(const xmlChar * localname, const xmlChar * URI, int nb_attributes, const xmlChar ** attributes) {
+	const char * name = (const char *)localname;
+	if (strcmp(name, "rss")==0) {
+		std::string version = attr(nb_attributes, attributes, "version", true);
+		if (version == "")
+			fail(_("no RSS version"));
+		else if (version == "0.91")
+			f.rss_version = RSS_0_91;
+		else if (version == "0.92")
+			f.rss_version = RSS_0_92;
+		else if (version == "0.94")
+			f.rss_version = RSS_0_94;
+		else if (version == "2.0" || version == "2")
+			f.rss_version = RSS_2_0;
+		else
+			fail(_("invalid RSS version"));
+		format = FORMAT_RSS;
+		return ROLE_RSS;
+	} else if (strcmp(name, "RDF")==0) {
+		f.rss_version = RSS_1_0;
+		format = FORMAT_RDF;
+		return ROLE_RDF;
+	} else if (strcmp(name, "feed")==0) {
+		format = FORMAT_ATOM;
+		if (!URI) {
+			fail(_("no Atom version"));
+		} else if (strcmp((const char *)URI, ATOM_0_3_URI)==0) {
+			f.rss_version = ATOM_0_3;
+			ns = ATOM_0_3_URI;
+		} else if (strcmp((const char *)URI, ATOM_1_0_URI)==0) {
+			f.rss_version = ATOM_1_0;
+			ns = ATOM_1_0_URI;
+		} else if (attr(nb_attributes, attributes, "version", true) == "0.3") {
+			f.rss_version = ATOM_0_3_NONS;
+			ns = NULL;
+		} else {
+			fail(_("invalid Atom version"));
+		}
+		f.language = attr(nb_attributes, attributes, "lang");
+		globalbase = attr(nb_attributes, attributes, "base", true);
+		return ROLE_ATOM;
+	}
+	format = FORMAT_OTHER;
+	fail(_("unsupported feed format"));
+	return ROLE_IGNORE;
+}
+
+int stream_parser::start_rss_channel_child(const xmlChar * localname, const xmlChar * URI) {
+	if (is(localname, URI, "title")) {
+		f.title_type = "text";
+		capture(f.title);
+	} else if (is(localname, URI, "link")) {
+		capture(f.link);
+	} else if (is(localname, URI, "description")) {
+		capture(f.description);
+	} else if (is(localname, URI, "language")) {
+		capture(f.language);
+	} else if (is(localname, URI, "managingEditor")) {
+		capture(f.managingeditor);
+	} else if (is(localname, URI, "item")) {
+		f.items.push_back(item());
+		dc_creator.clear();
+		return ROLE_RSS_ITEM;
+	} else {
+		return ROLE_IGNORE;
+	}
+	return ROLE_CAPTURE;
+}
+
+int stream_parser::start_rss_item_child(int parent, const xmlChar * localname, const xmlChar * URI, int nb_attributes, const xmlChar ** attributes) {
+	item& it = f.items.back();
+
+	if (parent == ROLE_MEDIA_GROUP) {
+		if (is(localname, URI, "content", MEDIA_RSS_URI)) {
+			it.enclosure_url = attr(nb_attributes, attributes, "url");
+			it.enclosure_type = attr(nb_attributes, attributes, "type");
+		}
+		return ROLE_IGNORE;
+	}
+
+	if (is(localname, URI, "title")) {
+		it.title_type = "text";
+		capture(it.title);
+	} else if (is(localname, URI, "link")) {
+		capture(it.link);
+	} else if (is(localname, URI, "description")) {
+		capture(it.description);
+	} else if (is(localname, URI, "encoded", CONTENT_URI)) {
+		capture(it.content_encoded);
+	} else if (is(localname, URI, "summary", ITUNES_URI)) {
+		capture(it.itunes_summary);
+	} else if (is(localname, URI, "guid")) {
+		it.guid_isPermaLink = (attr(nb_attributes, attributes, "isPermaLink") == "true");
+		capture(it.guid);
+	} else if (is(localname, URI, "pubDate")) {
+		capture(it.pubDate);
+	} else if (is(localname, URI, "author")) {
+		capture(scratch, ACTION_RSS_AUTHOR);
+	} else if (is(localname, URI, "creator", DC_URI)) {
+		capture(dc_creator);
+	} else if (is(localname, URI, "enclosure") || is(localname, URI, "content", MEDIA_RSS_URI)) {
+		it.enclosure_url = attr(nb_attributes, attributes, "url");
+		it.enclosure_type = attr(nb_attributes, attributes, "type");
+		return ROLE_IGNORE;
+	} else if (is(localname, URI, "group", MEDIA_RSS_URI)) {
+		return ROLE_MEDIA_GROUP;
+	} else {
+		return ROLE_IGNORE;
+	}
+	return ROLE_CAPTURE;
+}
+
+int stream_parser::start_rdf_child(const xmlChar * localname, const xmlChar * URI, int nb_attributes, const xmlChar ** attributes) {
+	if (is(localname, URI, "channel", RSS_1_0_NS)) {
+		return ROLE_RDF_CHANNEL;
+	} else if (is(localname, URI, "item", RSS_1_0_NS)) {
+		f.items.push_back(item());
+		f.items.back().guid = attr(nb_attributes, attributes, "about", true);
+		return ROLE_RDF_ITEM;
+	}
+	return ROLE_IGNORE;
+}
+
+int stream_parser::start_rdf_grandchild(int parent, const xmlChar * localname, const xmlChar * URI) {
+	if (parent == ROLE_RDF_CHANNEL) {
+		if (is(localname, URI, "title", RSS_1_0_NS)) {
+			f.title_type = "text";
+			capture(f.title);
+		} else if (is(localname, URI, "link", RSS_1_0_NS)) {
+			capture(f.link);
+		} else if (is(localname, URI, "description", RSS_1_0_NS)) {
+			capture(f.description);
+		} else if (is(localname, URI, "date", DC_URI)) {
+			capture(f.pubDate, ACTION_W3CDTF);
+		} else if (is(localname, URI, "creator", DC_URI)) {
+			capture(f.dc_creator);
+		} else {
+			return ROLE_IGNORE;
+		}
+		return ROLE_CAPTURE;
+	}
+
+	item& it = f.items.back();
+	if (is(localname, URI, "title", RSS_1_0_NS)) {
+		it.title_type = "text";
+		capture(it.title);
+	} else if (is(localname, URI, "link", RSS_1_0_NS)) {
+		capture(it.link);
+	} else if (is(localname, URI, "description", RSS_1_0_NS)) {
+		capture(it.description);
+	} else if (is(localname, URI, "date", DC_URI)) {
+		capture(it.pubDate, ACTION_W3CDTF);
+	} else if (is(localname, URI, "encoded", CONTENT_URI)) {
+		capture(it.content_encoded);
+	} else if (is(localname, URI, "summary", ITUNES_URI)) {
+		capture(it.itunes_summary);
+	} else {
+		return ROLE_IGNORE;
+	}
+	return ROLE_CAPTURE;
+}
+
+int stream_parser::start_atom_child(const xmlChar * localname, const xmlChar * URI, int nb_attributes, const xmlChar ** attributes) {
+	if (is(localname, URI, "title", ns)) {
+		f.title_type = attr(nb_attributes, attributes, "type");
+		if (f.title_type == "")
+			f.title_type = "text";
+		capture(f.title);
+	} else if (is(localname, URI, "subtitle", ns)) {
+		capture(f.description);
+	} else if (is(localname, URI, "link", ns)) {
+		if (attr(nb_attributes, attributes, "rel") == "alternate")
+			f.link = newsbeuter::utils::absolute_url(globalbase, attr(nb_attributes, attributes, "href"));
+		return ROLE_IGNORE;
+	} else if (is(localname, URI, "updated", ns)) {
+		capture(f.pubDate, ACTION_W3CDTF);
+	} else if (is(localname, URI, "entry", ns)) {
+		f.items.push_back(item());
+		entry_summary.clear();
+		entry_summary_type.clear();
+		entry_updated.clear();
+		entry_base = attr(nb_attributes, attributes, "base", true);
+		if (entry_base == "")
+			entry_base = globalbase;
+		return ROLE_ATOM_ENTRY;
+	} else {
+		return ROLE_IGNORE;
+	}
+	return ROLE_CAPTURE;
+}
+
+int stream_parser::start_atom_text(std::string& out, std::string& type, int nb_attributes, const xmlChar ** attributes) {
+	std::string mode = attr(nb_attributes, attributes, "mode");
+	type = attr(nb_attributes, attributes, "type");
+	int role = ROLE_IGNORE;
+	if (mode == "xml" || mode == "") {
+		capture(out, ACTION_NONE, !(type == "html" || type == "text"));
+		role = ROLE_CAPTURE;
+	} else if (mode == "escaped") {
+		capture(out);
+		role = ROLE_CAPTURE;
+	}
+	if (type == "")
+		type = "text";
+	return role;
+}
+
+int stream_parser::start_atom_entry_child(int parent, const xmlChar * localname, const xmlChar * URI, int nb_attributes, const xmlChar ** attributes) {
+	item& it = f.items.back();
+
+	if (parent == ROLE_ATOM_AUTHOR) {
+		if (is(localname, URI, "name", ns)) {
+			capture(it.author);
+			return ROLE_CAPTURE;
+		}
+		return ROLE_IGNORE;
+	}
+
+	if (is(localname, URI, "author", ns)) {
+		return ROLE_ATOM_AUTHOR;
+	} else if (is(localname, URI, "title", ns)) {
+		it.title_type = attr(nb_attributes, attributes, "type");
+		if (it.title_type == "")
+			it.title_type = "text";
+		capture(it.title);
+	} else if (is(localname, URI, "content", ns)) {
+		it.base = attr(nb_attributes, attributes, "base", true);
+		return start_atom_text(it.description, it.description_type, nb_attributes, attributes);
+	} else if (is(localname, URI, "id", ns)) {
+		it.guid_isPermaLink = false;
+		capture(it.guid);
+	} else if (is(localname, URI, "published", ns)) {
+		capture(it.pubDate, ACTION_W3CDTF);
+	} else if (is(localname, URI, "updated", ns)) {
+		capture(entry_updated, ACTION_W3CDTF);
+	} else if (is(localname, URI, "link", ns)) {
+		std::string rel = attr(nb_attributes, attributes, "rel");
+		if (rel == "" || rel == "alternate") {
+			it.link = newsbeuter::utils::absolute_url(entry_base, attr(nb_attributes, attributes, "href"));
+		} else if (rel == "enclosure") {
+			it.enclosure_url = attr(nb_attributes, attributes, "href");
+			it.enclosure_type = attr(nb_attributes, attributes, "type");
+		}
+		return ROLE_IGNORE;
+	} else if (is(localname, URI, "summary", ns)) {
+		return start_atom_text(entry_summary, entry_summary_type, nb_attributes, attributes);
+	} else if (is(localname, URI, "category", ns)) {
+		if (attr(nb_attributes, attributes, "scheme") == "http://www.google.com/reader/")
+			it.labels.push_back(attr(nb_attributes, attributes, "label"));
+		return ROLE_IGNORE;
+	} else {
+		return ROLE_IGNORE;
+	}
+	return ROLE_CAPTURE;
+}
+
+void stream_parser::end_element(void * ctx, const xmlChar * localname, const xmlChar * prefix, const xmlChar * URI) {
+	stream_parser * sp = get(ctx);
+	if (!sp) {
+		xmlSAX2EndElementNs(ctx, localname, prefix, URI);
+		return;
+	}
+	if (sp->roles.size() == 0)
+		return;
+
+	int role = sp->roles.back();
+	sp->roles.pop_back();
+
+	if (sp->capture_depth >= 0) {
+		if (sp->capture_xml)
+			xmlSAX2EndElementNs(ctx, localname, prefix, URI);
+		if (static_cast<int>(sp->roles.size()) == sp->capture_depth)
+			sp->end_capture();
+		return;
+	}
+
+	switch (role) {
+		case ROLE_RSS_CHANNEL:
+			// like rss_09x_parser, only the first channel is read, so
+			// there is no need to parse the rest of the document.
+			xmlStopParser(sp->ctxt);
+			break;
+		case ROLE_RSS_ITEM:
+			if (sp->f.items.back().author == "")
+				sp->f.items.back().author = sp->dc_creator;
+			break;
+		case ROLE_ATOM_ENTRY: {
+				item& it = sp->f.items.back();
+				if (it.description == "") {
+					it.description = sp->entry_summary;
+					it.description_type = sp->entry_summary_type;
+				}
+				if (it.pubDate == "") {
+					it.pubDate = sp->entry_updated;
+				}
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+void stream_parser::end_capture() {
+	if (capture_xml && capture_node) {
+		xmlBufferPtr buf = xmlBufferCreate();
+		for (xmlNodePtr ptr = capture_node->children; ptr != NULL; ptr = ptr->next) {
+			if (xmlNodeDump(buf, ctxt->myDoc, ptr, 0, 0) >= 0) {
+				target->append((const char *)xmlBufferContent(buf));
+				xmlBufferEmpty(buf);
+			} else {
+				xmlChar * content = xmlNodeGetContent(ptr);
+				if (content) {
+					target->append((const char *)content);
+					xmlFree(content);
+				}
+			}
+		}
+		xmlBufferFree(buf);
+		xmlUnlinkNode(capture_node);
+		xmlFreeNode(capture_node);
+		capture_node = NULL;
+	}
+
+	switch (action) {
+		case ACTION_W3CDTF:
+			*target = rss_parser::__w3cdtf_to_rfc822(*target);
+			break;
+		case ACTION_RSS_AUTHOR: {
+				item& it = f.items.back();
+				const std::string& authorfield = *target;
+				if (authorfield.length() > 0 && authorfield[authorfield.length()-1] == ')') {
+					it.author_email = newsbeuter::utils::tokenize(authorfield, " ")[0];
+					unsigned int start, end;
+					end = authorfield.length()-2;
+					for (start = end;start > 0 && authorfield[start] != '(';start--) { }
+					it.author = authorfield.substr(start+1, end-start);
+				} else {
+					it.author_email = authorfield;
+					it.author = authorfield;
+				}
+			}
+			break;
+		default:
+			break;
+	}
+
+	target = NULL;
+	capture_depth = -1;
+	capture_xml = false;
+	action = ACTION_NONE;
+}
+
+void stream_parser::characters(void * ctx, const xmlChar * ch, int len) {
+	stream_parser * sp = get(ctx);
+	if (!sp) {
+		xmlSAX2Characters(ctx, ch, len);
+		return;
+	}
+	if (sp->capture_depth < 0)
+		return;
+	if (sp->capture_xml)
+		xmlSAX2Characters(ctx, ch, len);
+	else
+		sp->target->append((const char *)ch, len);
+}
+
+void stream_parser::cdata(void * ctx, const xmlChar * value, int len) {
+	stream_parser * sp = get(ctx);
+	if (!sp) {
+		xmlSAX2CDataBlock(ctx, value, len);
+		return;
+	}
+	if (sp->capture_depth < 0)
+		return;
+	if (sp->capture_xml)
+		xmlSAX2CDataBlock(ctx, value, len);
+	else
+		sp->target->append((const char *)value, len);
+}
+
+void stream_parser::reference(void * ctx, const xmlChar * name) {
+	stream_parser * sp = get(ctx);
+	if (!sp) {
+		xmlSAX2Reference(ctx, name);
+		return;
+	}
+	if (sp->capture_depth < 0)
+		return;
+	if (sp->capture_xml) {
+		xmlSAX2Reference(ctx, name);
+		return;
+	}
+	// this is what xmlNodeGetContent() does for an entity reference node.
+	xmlEntityPtr ent = xmlGetDocEntity(sp->ctxt->myDoc, name);
+	if (ent) {
+		for (xmlNodePtr ptr = ent->children; ptr != NULL; ptr = ptr->next) {
+			xmlChar * content = xmlNodeGetContent(ptr);
+			if (content) {
+				sp->target->append((const char *)content);
+				xmlFree(content);
+			}
+		}
+	}
+}
+
+void stream_parser::comment(void * ctx, const xmlChar * value) {
+	stream_parser * sp = get(ctx);
+	if (!sp || (sp->capture_depth >= 0 && sp->capture_xml))
+		xmlSAX2Comment(ctx, value);
+}
+
+void stream_parser::processing_instruction(void * ctx, const xmlChar * target, const xmlChar * data) {
+	stream_parser * sp = get(ctx);
+	if (!sp || (sp->capture_depth >= 0 && sp->capture_xml))
+		xmlSAX2ProcessingInstruction(ctx, target, data);
+}
+
+}
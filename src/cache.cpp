@@ -29,6 +29,11 @@ struct header_values {
 	std::string etag;
 };
 
+struct failure_state {
+	unsigned int failures;
+	time_t next_retry;
+};
+
 static int count_callback(void * handler, int argc, char ** argv, char ** /* azColName */) {
 	cb_handler * cbh = static_cast<cb_handler *>(handler);
 
@@ -83,6 +88,21 @@ static int lastmodified_callback(void * handler, int argc, char ** argv, char **
 	return 0;
 }
 
+static int failurestate_callback(void * handler, int argc, char ** argv, char ** /* azColName */) {
+	failure_state * result = static_cast<failure_state *>(handler);
+	assert(argc == 2);
+	assert(result != NULL);
+	if (argv[0]) {
+		std::istringstream is(argv[0]);
+		is >> result->failures;
+	}
+	if (argv[1]) {
+		std::istringstream is(argv[1]);
+		is >> result->next_retry;
+	}
+	return 0;
+}
+
 static int vectorofstring_callback(void * vp, int argc, char ** argv, char ** /* azColName */) {
 	std::vector<std::string> * vectorptr = static_cast<std::vector<std::string> *>(vp);
 	assert(argc == 1);
@@ -117,7 +137,7 @@ static int rssitem_callback(void * myfeed, int argc, char ** argv, char ** /* az
 	item->set_flags(argv[11] ? argv[11] : "");
 	item->set_base(argv[12] ? argv[12] : "");
 
-	(*feed)->items().push_back(item);
+	(*feed)->add_item(item);
 	return 0;
 }
 
@@ -297,6 +317,12 @@ void cache::populate_tables() {
 
 	rc = sqlite3_exec(db, "ALTER TABLE rss_item ADD base VARCHAR(128) NOT NULL DEFAULT \"\";", NULL, NULL, NULL);
 	LOG(LOG_DEBUG, "cache::populate_tables: ALTER TABLE rss_feed(10) rc = %d", rc);
+
+	rc = sqlite3_exec(db, "ALTER TABLE rss_feed ADD failures INTEGER(11) NOT NULL DEFAULT 0;", NULL, NULL, NULL);
+	LOG(LOG_DEBUG, "cache::populate_tables: ALTER TABLE rss_feed (11) rc = %d", rc);
+
+	rc = sqlite3_exec(db, "ALTER TABLE rss_feed ADD next_retry INTEGER(11) NOT NULL DEFAULT 0;", NULL, NULL, NULL);
+	LOG(LOG_DEBUG, "cache::populate_tables: ALTER TABLE rss_feed (12) rc = %d", rc);
 }
 
 
@@ -332,6 +358,38 @@ void cache::update_lastmodified(const std::string& feedurl, time_t t, const std:
 	LOG(LOG_DEBUG, "ran SQL statement: %s result = %d", query.c_str(), rc);
 }
 
+void cache::fetch_failure_state(const std::string& feedurl, unsigned int& failures, time_t& next_retry) {
+	scope_mutex lock(&mtx);
+	std::string query = prepare_query("SELECT failures, next_retry FROM rss_feed WHERE rssurl = '%q';", feedurl.c_str());
+	failure_state result = { 0, 0 };
+	int rc = sqlite3_exec(db, query.c_str(), failurestate_callback, &result, NULL);
+	if (rc != SQLITE_OK) {
+		LOG(LOG_CRITICAL, "query \"%s\" failed: error = %d", query.c_str(), rc);
+		throw dbexception(db);
+	}
+	failures = result.failures;
+	next_retry = result.next_retry;
+}
+
+void cache::update_failure_state(const std::string& feedurl, unsigned int failures, time_t next_retry) {
+	scope_mutex lock(&mtx);
+	if (failures == 0) {
+		std::string query = prepare_query("UPDATE rss_feed SET failures = 0, next_retry = 0 WHERE rssurl = '%q' AND failures > 0;", feedurl.c_str());
+		int rc = sqlite3_exec(db, query.c_str(), NULL, NULL, NULL);
+		LOG(LOG_DEBUG, "ran SQL statement: %s result = %d", query.c_str(), rc);
+		return;
+	}
+	std::string query = prepare_query("UPDATE rss_feed SET failures = %u, next_retry = %lld WHERE rssurl = '%q';", failures, static_cast<long long>(next_retry), feedurl.c_str());
+	int rc = sqlite3_exec(db, query.c_str(), NULL, NULL, NULL);
+	LOG(LOG_DEBUG, "ran SQL statement: %s result = %d", query.c_str(), rc);
+	if (rc == SQLITE_OK && sqlite3_changes(db) == 0) {
+		// the feed has never been loaded successfully, so there is no row for it yet.
+		query = prepare_query("INSERT INTO rss_feed (rssurl, url, title, failures, next_retry) VALUES ( '%q', '', '', %u, %lld );", feedurl.c_str(), failures, static_cast<long long>(next_retry));
+		rc = sqlite3_exec(db, query.c_str(), NULL, NULL, NULL);
+		LOG(LOG_DEBUG, "ran SQL statement: %s result = %d", query.c_str(), rc);
+	}
+}
+
 void cache::mark_item_deleted(const std::string& guid, bool b) {
 	scope_mutex lock(&mtx);
 	std::string query = prepare_query("UPDATE rss_item SET deleted = %u WHERE guid = '%q'", b ? 1 : 0, guid.c_str());
@@ -388,7 +446,7 @@ void cache::externalize_rssfeed(std::tr1::shared_ptr<rss_feed> feed, bool reset_
 		for (unsigned int i=0;i<max_items;++i)
 			++it;	
 		if (it != feed->items().end())
-			feed->items().erase(it, feed->items().end()); // delete entries that are too much
+			feed->erase_items(it, feed->items().end()); // delete entries that are too much
 	}
 
 	unsigned int days = cfg->get_configvalue_as_int("keep-articles-days");
@@ -401,6 +459,23 @@ void cache::externalize_rssfeed(std::tr1::shared_ptr<rss_feed> feed, bool reset_
 	}
 }
 
+struct item_is_ignored {
+	item_is_ignored(rss_ignores * i) : ign(i) { }
+	bool operator()(const std::tr1::shared_ptr<rss_item>& item) const {
+		return ign->matches(item.get());
+	}
+	rss_ignores * ign;
+};
+
+struct item_is_expired {
+	item_is_expired(unsigned int max) : max_items(max), pos(0) { }
+	bool operator()(const std::tr1::shared_ptr<rss_item>& item) {
+		return pos++ >= max_items && item->flags().length() == 0;
+	}
+	unsigned int max_items;
+	unsigned int pos;
+};
+
 // this function reads an rss_feed including all of its rss_items.
 // the feed parameter needs to have the rssurl member set.
 void cache::internalize_rssfeed(std::tr1::shared_ptr<rss_feed> feed, rss_ignores * ign) {
@@ -434,7 +509,7 @@ void cache::internalize_rssfeed(std::tr1::shared_ptr<rss_feed> feed, rss_ignores
 		throw dbexception(db);
 	}
 
-	feed->items().clear();
+	feed->clear_items();
 
 	/* ...and then the associated items */
 	query = prepare_query("SELECT guid,title,author,url,pubDate,content,unread,feedurl,enclosure_url,enclosure_type,enqueued,flags,base FROM rss_item WHERE feedurl = '%q' AND deleted = 0 ORDER BY pubDate DESC, id DESC;",feed->rssurl().c_str());
@@ -445,19 +520,10 @@ void cache::internalize_rssfeed(std::tr1::shared_ptr<rss_feed> feed, rss_ignores
 		throw dbexception(db);
 	}
 
-	unsigned int i=0;
-	for (std::vector<std::tr1::shared_ptr<rss_item> >::iterator it=feed->items().begin(); it != feed->items().end(); ++it,++i) {
-		if (ign && ign->matches(it->get())) {
-			feed->items().erase(it);
-			// since we modified the vector, we need to reset the iterator
-			// to the beginning of the vector, and then fast-forward to
-			// the next element.
-			it = feed->items().begin();
-			for (int j=0;j<int(i)-1;j++) {
-				it++;
-			}
-			continue;
-		}
+	if (ign) {
+		feed->remove_items_if(item_is_ignored(ign));
+	}
+	for (std::vector<std::tr1::shared_ptr<rss_item> >::iterator it=feed->items().begin(); it != feed->items().end(); ++it) {
 		(*it)->set_cache(this);
 		(*it)->set_feedptr(feed);
 		(*it)->set_feedurl(feed->rssurl());
@@ -466,20 +532,11 @@ void cache::internalize_rssfeed(std::tr1::shared_ptr<rss_feed> feed, rss_ignores
 	unsigned int max_items = cfg->get_configvalue_as_int("max-items");
 	
 	if (max_items > 0 && feed->items().size() > max_items) {
-		std::vector<std::tr1::shared_ptr<rss_item> > flagged_items;
-		std::vector<std::tr1::shared_ptr<rss_item> >::iterator it=feed->items().begin();
-		for (unsigned int i=0;i<max_items;++i)
-			++it;
-		for (unsigned int i=max_items;i<feed->items().size();++i) {
-			if (feed->items()[i]->flags().length() == 0) {
-				delete_item(feed->items()[i]);
-			} else {
-				flagged_items.push_back(feed->items()[i]);
-			}
-		}	
-		feed->items().erase(it, feed->items().end()); // delete old entries
-		if (flagged_items.size() > 0) {
-			feed->items().insert(feed->items().end(), flagged_items.begin(), flagged_items.end()); // if some flagged articles were saved, append them
+		// drop the unflagged entries beyond max_items; flagged articles are
+		// kept and end up after the first max_items entries.
+		std::vector<std::tr1::shared_ptr<rss_item> > old_items = feed->remove_items_if(item_is_expired(max_items));
+		for (std::vector<std::tr1::shared_ptr<rss_item> >::iterator it=old_items.begin();it!=old_items.end();++it) {
+			delete_item(*it);
 		}
 	}
 	feed->sort_unlocked(cfg->get_configvalue("article-sort-order"));
@@ -926,6 +983,18 @@ void cache::clean_old_articles() {
 	}
 }
 
+void cache::begin_transaction() {
+	scope_mutex lock(&mtx);
+	int rc = sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+	LOG(LOG_DEBUG, "cache::begin_transaction: rc = %d", rc);
+}
+
+void cache::end_transaction() {
+	scope_mutex lock(&mtx);
+	int rc = sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL);
+	LOG(LOG_DEBUG, "cache::end_transaction: rc = %d", rc);
+}
+
 scope_transaction::scope_transaction(sqlite3 * db) : d(db) {
 	int rc = sqlite3_exec(d, "BEGIN TRANSACTION", NULL, NULL, NULL);
 	LOG(LOG_DEBUG,"scope_transaction: started transaction for handle: %p, rc = %d", d, rc);
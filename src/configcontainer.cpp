@@ -82,6 +82,8 @@ configcontainer::configcontainer()
 	config_data["download-retries"] = configdata("1", configdata::INT);
 	config_data["feed-sort-order"] = configdata("none-desc", configdata::STR);
 	config_data["reload-threads"] = configdata("1", configdata::INT);
+	config_data["plugin-processes"] = configdata("4", configdata::INT);
+	config_data["plugin-timeout"] = configdata("120", configdata::INT);
 	config_data["keep-articles-days"] = configdata("0", configdata::INT);
 	config_data["bookmark-interactive"] = configdata("false", configdata::BOOL);
 	config_data["mark-as-read-on-hover"] = configdata("false", configdata::BOOL);
@@ -5,6 +5,7 @@
 #include <configcontainer.h>
 #include <exceptions.h>
 #include <downloadthread.h>
+#include <reloadpipeline.h>
 #include <colormanager.h>
 #include <logger.h>
 #include <utils.h>
@@ -55,6 +56,8 @@ std::string lock_file;
 
 int ctrl_c_hit = 0;
 
+cancel_token reload_cancel;
+
 void ctrl_c_action(int sig) {
 	LOG(LOG_DEBUG,"caught signal %d",sig);
 	if (SIGINT == sig) {
@@ -66,6 +69,10 @@ void ctrl_c_action(int sig) {
 	}
 }
 
+void cancel_reload_action(int /* sig */) {
+	reload_cancel.cancel();
+}
+
 void ignore_signal(int sig) {
 	LOG(LOG_WARN, "caught signal %d but ignored it", sig);
 }
@@ -76,7 +83,7 @@ void omg_a_child_died(int /* sig */) {
 	while ((pid = waitpid(-1,&stat,WNOHANG)) > 0) { }
 }
 
-controller::controller() : v(0), urlcfg(0), rsscache(0), url_file("urls"), cache_file("cache.db"), config_file("config"), queue_file("queue"), refresh_on_start(false), api(0) {
+controller::controller() : v(0), urlcfg(0), rsscache(0), reload_failures(0), url_file("urls"), cache_file("cache.db"), config_file("config"), queue_file("queue"), refresh_on_start(false), active_pipeline(0), api(0) {
 	char * cfgdir;
 	if (!(cfgdir = ::getenv("HOME"))) {
 		struct passwd * spw = ::getpwuid(::getuid());
@@ -96,13 +103,14 @@ controller::controller() : v(0), urlcfg(0), rsscache(0), url_file("urls"), cache
 }
 
 controller::~controller() {
+	delete reload_failures;
 	delete rsscache;
 	delete urlcfg;
 	delete api;
 
 	for (std::vector<std::tr1::shared_ptr<rss_feed> >::iterator it=feeds.begin();it!=feeds.end();it++) {
 		scope_mutex lock(&((*it)->item_mutex));
-		(*it)->items().clear();
+		(*it)->clear_items();
 	}
 	feeds.clear();
 }
@@ -124,6 +132,7 @@ void controller::run(int argc, char * argv[]) {
 	::signal(SIGPIPE, ignore_signal);
 	::signal(SIGHUP, ctrl_c_action);
 	::signal(SIGCHLD, omg_a_child_died);
+	::signal(SIGUSR1, cancel_reload_action);
 
 	bool do_import = false, do_export = false, cachefile_given_on_cmdline = false, do_vacuum = false;
 	bool offline_mode = false, real_offline_mode = false;
@@ -315,6 +324,7 @@ void controller::run(int argc, char * argv[]) {
 	}
 	try {
 		rsscache = new cache(cache_file,&cfg);
+		reload_failures = new failure_tracker(rsscache);
 	} catch (const dbexception& e) {
 		std::cout << utils::strprintf(_("Error: opening the cache file `%s' failed: %s"), cache_file.c_str(), e.what()) << std::endl;
 		utils::remove_fs_lock(lock_file);
@@ -582,8 +592,17 @@ void controller::reload(unsigned int pos, unsigned int max, bool unattended) {
 
 		rss_parser parser(feed->rssurl().c_str(), rsscache, &cfg, ignore_dl ? &ign : NULL, api);
 		LOG(LOG_DEBUG, "controller::reload: created parser");
+		bool host_down = false;
 		try {
-			feed = parser.parse();
+			/*
+			 * reloading a single feed is always an explicit request by the
+			 * user, so it doesn't ask reload_failures whether the feed or its
+			 * host are backing off, but the result still counts.
+			 */
+			parser.fetch();
+			feed = parser.build_feed();
+			parser.commit(feed);
+			reload_failures->record_success(feed->rssurl());
 			if (feed->items().size() > 0) {
 				save_feed(feed, pos);
 				enqueue_items(feed);
@@ -599,8 +618,10 @@ void controller::reload(unsigned int pos, unsigned int max, bool unattended) {
 			errmsg = utils::strprintf(_("Error while retrieving %s: %s"), utils::censor_url(feed->rssurl()).c_str(), emsg.c_str());
 		} catch (rsspp::exception& e) {
 			errmsg = utils::strprintf(_("Error while retrieving %s: %s"), utils::censor_url(feed->rssurl()).c_str(), e.what());
+			host_down = failure_tracker::is_host_error(e.curl_error());
 		}
 		if (errmsg != "") {
+			reload_failures->record_failure(feed->rssurl(), host_down);
 			v->set_status(errmsg);
 			LOG(LOG_USERERROR, "%s", errmsg.c_str());
 		}
@@ -609,6 +630,25 @@ void controller::reload(unsigned int pos, unsigned int max, bool unattended) {
 	}
 }
 
+void controller::bump_reload_priority(unsigned int pos) {
+	/*
+	 * the feed that was bumped last is considered the focused feed; it is
+	 * reloaded first by every subsequent reload, and by a currently running
+	 * reload as soon as the next download slot becomes free.
+	 */
+	scope_mutex lock(&reload_prio_mtx);
+	if (pos < feeds.size()) {
+		focused_feed = feeds[pos]->rssurl();
+		if (active_pipeline)
+			active_pipeline->bump(pos);
+	}
+}
+
+void controller::cancel_reload() {
+	LOG(LOG_INFO, "controller::cancel_reload: cancelling running reload");
+	reload_cancel.cancel();
+}
+
 std::tr1::shared_ptr<rss_feed> controller::get_feed(unsigned int pos) {
 	if (pos >= feeds.size()) {
 		throw std::out_of_range(_("invalid feed index (bug)"));
@@ -621,9 +661,8 @@ void controller::reload_indexes(const std::vector<int>& indexes, bool unattended
 	unsigned int unread_feeds, unread_articles;
 	compute_unread_numbers(unread_feeds, unread_articles);
 
-	for (std::vector<int>::const_iterator it=indexes.begin();it!=indexes.end();++it) {
-		this->reload(*it,feeds.size(), unattended);
-	}
+	reload_pipeline pipeline(this, indexes, unattended);
+	pipeline.run();
 
 	unsigned int unread_feeds2, unread_articles2;
 	compute_unread_numbers(unread_feeds2, unread_articles2);
@@ -636,49 +675,25 @@ void controller::reload_indexes(const std::vector<int>& indexes, bool unattended
 		fmt.register_fmt('D', utils::to_s(unread_feeds2 - unread_feeds));
 		this->notify(fmt.do_format(cfg.get_configvalue("notify-format")));
 	}
-	if (!unattended)
+	if (!unattended && !reload_cancel.is_cancelled() && pipeline.get_skipped() == 0)
 		v->set_status("");
 }
 
-void controller::reload_range(unsigned int start, unsigned int end, unsigned int size, bool unattended) {
-	for (unsigned int i=start;i<=end;i++) {
-		LOG(LOG_DEBUG, "controller::reload_range: reloading feed #%u", i);
-		this->reload(i, size, unattended);
-	}
-}
-
 void controller::reload_all(bool unattended) {
 	unsigned int unread_feeds, unread_articles;
 	compute_unread_numbers(unread_feeds, unread_articles);
-	unsigned int num_threads = cfg.get_configvalue_as_int("reload-threads");
 	time_t t1, t2, dt;
 
-	if (num_threads < 1)
-		num_threads = 1;
-
-	if (num_threads > feeds.size())
-		num_threads = feeds.size();
+	std::vector<int> indexes;
+	for (unsigned int i=0;i<feeds.size();i++) {
+		indexes.push_back(i);
+	}
 
 	t1 = time(NULL);
 
 	LOG(LOG_DEBUG,"controller::reload_all: starting with reload all...");
-	if (num_threads <= 1) {
-		this->reload_range(0, feeds.size()-1, feeds.size(), unattended);
-	} else {
-		std::vector<std::pair<unsigned int, unsigned int> > partitions = utils::partition_indexes(0, feeds.size()-1, num_threads);
-		std::vector<pthread_t> threads;
-		LOG(LOG_DEBUG, "controller::reload_all: starting reload threads...");
-		for (unsigned int i=0;i<num_threads-1;i++) {
-			reloadrangethread* t = new reloadrangethread(this, partitions[i].first, partitions[i].second, feeds.size(), unattended);
-			threads.push_back(t->start());
-		}
-		LOG(LOG_DEBUG, "controller::reload_all: starting my own reload...");
-		this->reload_range(partitions[num_threads-1].first, partitions[num_threads-1].second, feeds.size(), unattended);
-		LOG(LOG_DEBUG, "controller::reload_all: joining other threads...");
-		for (std::vector<pthread_t>::iterator it=threads.begin();it!=threads.end();it++) {
-			::pthread_join(*it, NULL);
-		}
-	}
+	reload_pipeline pipeline(this, indexes, unattended);
+	pipeline.run();
 
 	t2 = time(NULL);
 	dt = t2 - t1;
@@ -1159,7 +1174,7 @@ void controller::save_feed(std::tr1::shared_ptr<rss_feed> feed, unsigned int pos
 		feed->set_tags(urlcfg->get_tags(feed->rssurl()));
 		{
 			scope_mutex itemlock(&feeds[pos]->item_mutex);
-			feeds[pos]->items().clear();
+			feeds[pos]->clear_items();
 		}
 		feeds[pos] = feed;
 		v->notify_itemlist_change(feeds[pos]);
@@ -0,0 +1,174 @@
+#include <failuretracker.h>
+#include <exceptions.h>
+#include <logger.h>
+#include <utils.h>
+
+#include <libxml/uri.h>
+
+#define FEED_BACKOFF_BASE	(5*60)
+#define FEED_BACKOFF_MAX	(24*60*60)
+#define HOST_FAILURE_THRESHOLD	3
+#define HOST_BACKOFF_BASE	(10*60)
+#define HOST_BACKOFF_MAX	(6*60*60)
+
+namespace newsbeuter {
+
+/*
+ * The failure tracker keeps feeds that fail to reload from costing a full
+ * download timeout on every reload:
+ *
+ *   - every feed has a failure count and a "next retry" time in the cache.
+ *     After each failure, the retry time is pushed out with a jittered
+ *     exponential backoff; a successful reload resets both.
+ *   - every host has a circuit breaker. When HOST_FAILURE_THRESHOLD downloads
+ *     from a host fail in a row because the host can't be reached (it can't
+ *     be resolved, the connection is refused or times out), all of its feeds
+ *     are skipped for a while. After that, a single feed is let through as a
+ *     probe: if it succeeds (or the host answers at all), the circuit is
+ *     closed again, otherwise it stays open for twice as long. Downloads that
+ *     were already running when the circuit opened don't count.
+ */
+
+failure_tracker::failure_tracker(cache * c) : ch(c) { }
+
+failure_tracker::~failure_tracker() { }
+
+time_t failure_tracker::current_time() {
+	return ::time(NULL);
+}
+
+bool failure_tracker::is_host_error(CURLcode code) {
+	switch (code) {
+		case CURLE_COULDNT_RESOLVE_PROXY:
+		case CURLE_COULDNT_RESOLVE_HOST:
+		case CURLE_COULDNT_CONNECT:
+		case CURLE_OPERATION_TIMEDOUT:
+			return true;
+		default:
+			return false;
+	}
+}
+
+time_t failure_tracker::backoff_delay(unsigned int failures, time_t base, time_t max) {
+	if (failures == 0)
+		return 0;
+	time_t delay = base;
+	for (unsigned int i=1;i<failures && delay < max;i++) {
+		delay *= 2;
+	}
+	if (delay > max)
+		delay = max;
+	// jitter the delay by +/- 25% so that failing feeds don't all come back at once
+	return delay - delay/4 + utils::get_random_value(delay/2 + 1);
+}
+
+std::string failure_tracker::get_host(const std::string& rssurl) {
+	if (!utils::is_http_url(rssurl))
+		return "";
+	std::string host;
+	xmlURIPtr uri = xmlParseURI(rssurl.c_str());
+	if (uri) {
+		if (uri->server)
+			host = uri->server;
+		xmlFreeURI(uri);
+	}
+	return host;
+}
+
+bool failure_tracker::may_reload(const std::string& rssurl) {
+	time_t now = current_time();
+
+	unsigned int failures = 0;
+	time_t next_retry = 0;
+	try {
+		ch->fetch_failure_state(rssurl, failures, next_retry);
+	} catch (const dbexception& e) {
+		LOG(LOG_ERROR, "failure_tracker::may_reload: couldn't fetch failure state of %s: %s", rssurl.c_str(), e.what());
+	}
+	if (now < next_retry) {
+		LOG(LOG_INFO, "failure_tracker::may_reload: skipping %s after %u failures, next retry in %d seconds", rssurl.c_str(), failures, next_retry - now);
+		return false;
+	}
+
+	std::string host = get_host(rssurl);
+	if (host.length() == 0)
+		return true;
+
+	scope_mutex lock(&mtx);
+	std::map<std::string, host_state>::iterator it = hosts.find(host);
+	if (it == hosts.end() || it->second.open_until == 0)
+		return true;
+
+	host_state& hs = it->second;
+	if (now < hs.open_until || hs.probe.length() > 0) {
+		LOG(LOG_INFO, "failure_tracker::may_reload: circuit for host %s is open, skipping %s", host.c_str(), rssurl.c_str());
+		return false;
+	}
+
+	LOG(LOG_INFO, "failure_tracker::may_reload: probing host %s with %s", host.c_str(), rssurl.c_str());
+	hs.probe = rssurl;
+	return true;
+}
+
+void failure_tracker::record_success(const std::string& rssurl) {
+	ch->update_failure_state(rssurl, 0, 0);
+
+	std::string host = get_host(rssurl);
+	if (host.length() > 0) {
+		scope_mutex lock(&mtx);
+		hosts.erase(host);
+	}
+}
+
+void failure_tracker::record_failure(const std::string& rssurl, bool host_down) {
+	unsigned int failures = 0;
+	time_t next_retry = 0;
+	try {
+		ch->fetch_failure_state(rssurl, failures, next_retry);
+		failures++;
+		next_retry = current_time() + backoff_delay(failures, FEED_BACKOFF_BASE, FEED_BACKOFF_MAX);
+		LOG(LOG_INFO, "failure_tracker::record_failure: %s failed %u times, next retry at %d", rssurl.c_str(), failures, next_retry);
+		ch->update_failure_state(rssurl, failures, next_retry);
+	} catch (const dbexception& e) {
+		LOG(LOG_ERROR, "failure_tracker::record_failure: couldn't update failure state of %s: %s", rssurl.c_str(), e.what());
+	}
+
+	std::string host = get_host(rssurl);
+	if (host.length() == 0)
+		return;
+
+	scope_mutex lock(&mtx);
+	if (!host_down) {
+		hosts.erase(host);
+		return;
+	}
+	host_state& hs = hosts[host];
+	if (hs.open_until == 0) {
+		if (++hs.failures >= HOST_FAILURE_THRESHOLD)
+			trip(hs, host);
+	} else if (hs.probe == rssurl) {
+		trip(hs, host);
+	}
+}
+
+void failure_tracker::record_dropped(const std::string& rssurl) {
+	std::string host = get_host(rssurl);
+	if (host.length() == 0)
+		return;
+
+	scope_mutex lock(&mtx);
+	std::map<std::string, host_state>::iterator it = hosts.find(host);
+	if (it != hosts.end() && it->second.probe == rssurl) {
+		LOG(LOG_DEBUG, "failure_tracker::record_dropped: probe %s for host %s was dropped", rssurl.c_str(), host.c_str());
+		it->second.probe.clear();
+	}
+}
+
+void failure_tracker::trip(host_state& hs, const std::string& host) {
+	hs.trips++;
+	hs.probe.clear();
+	hs.open_until = current_time() + backoff_delay(hs.trips, HOST_BACKOFF_BASE, HOST_BACKOFF_MAX);
+	LOG(LOG_INFO, "failure_tracker::trip: opened circuit for host %s after %u failures (trip #%u)", host.c_str(), hs.failures, hs.trips);
+}
+
+}
@@ -339,18 +339,40 @@ void feedlist_formaction::update_visible_feeds(std::vector<std::tr1::shared_ptr<
 
 	visible_feeds.clear();
 
+	std::vector<matchable *> candidates;
+	std::vector<unsigned int> positions;
 	unsigned int i = 0;
 
 	for (std::vector<std::tr1::shared_ptr<rss_feed> >::iterator it = feeds.begin(); it != feeds.end(); ++it, ++i) {
 		(*it)->set_index(i+1);
-		if ((tag == "" || (*it)->matches_tag(tag)) && (!apply_filter || m.matches(it->get()))) {
-			visible_feeds.push_back(feedptr_pos_pair(*it,i));
+		if (tag == "" || (*it)->matches_tag(tag)) {
+			candidates.push_back(it->get());
+			positions.push_back(i);
+		}
+	}
+
+	std::vector<char> results(candidates.size(), 1);
+	if (apply_filter) {
+		m.matches_all(candidates, results);
+	}
+
+	for (i=0;i<positions.size();++i) {
+		if (results[i]) {
+			visible_feeds.push_back(feedptr_pos_pair(feeds[positions[i]], positions[i]));
 		}
 	}
 
 	feeds_shown = visible_feeds.size();
 }
 
+std::vector<unsigned int> feedlist_formaction::get_visible_positions() {
+	std::vector<unsigned int> positions;
+	for (std::vector<feedptr_pos_pair>::iterator it=visible_feeds.begin();it!=visible_feeds.end();++it) {
+		positions.push_back(it->second);
+	}
+	return positions;
+}
+
 void feedlist_formaction::set_feedlist(std::vector<std::tr1::shared_ptr<rss_feed> >& feeds) {
 	assert(v->get_cfg() != NULL); // must not happen
 
@@ -644,7 +666,7 @@ void feedlist_formaction::op_start_search() {
 		}
 		if (items.size() > 0) {
 			search_dummy_feed->item_mutex.lock();
-			search_dummy_feed->items() = items;
+			search_dummy_feed->set_items(items);
 			search_dummy_feed->item_mutex.unlock();
 			v->push_searchresult(search_dummy_feed, searchphrase);
 		} else {
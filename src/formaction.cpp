@@ -126,6 +126,9 @@ void formaction::process_op(operation op, bool automatic, std::vector<std::strin
 		case OP_PREVDIALOG:
 			v->goto_prev_dialog();
 			break;
+		case OP_CANCELRELOAD:
+			v->get_ctrl()->cancel_reload();
+			break;
 		default:
 			this->process_operation(op, automatic, args);
 	}
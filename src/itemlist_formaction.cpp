@@ -524,7 +524,7 @@ void itemlist_formaction::qna_start_search() {
 
 	{
 	    scope_mutex lock(&search_dummy_feed->item_mutex);
-	    search_dummy_feed->items() = items;
+	    search_dummy_feed->set_items(items);
 	}
 
 	if (show_searchresult) {
@@ -550,11 +550,21 @@ void itemlist_formaction::do_update_visible_items() {
 	 * (if applicable) whether an items matches the currently active filter.
 	 */
 
+	std::vector<matchable *> candidates;
 	unsigned int i=0;
 	for (std::vector<std::tr1::shared_ptr<rss_item> >::iterator it = items.begin(); it != items.end(); ++it, ++i) {
 		(*it)->set_index(i+1);
-		if (!apply_filter || m.matches(it->get())) {
-			visible_items.push_back(itemptr_pos_pair(*it, i));
+		candidates.push_back(it->get());
+	}
+
+	std::vector<char> results(items.size(), 1);
+	if (apply_filter) {
+		m.matches_all(candidates, results);
+	}
+
+	for (i=0;i<items.size();++i) {
+		if (results[i]) {
+			visible_items.push_back(itemptr_pos_pair(items[i], i));
 		}
 	}
 
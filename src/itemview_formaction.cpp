@@ -61,7 +61,9 @@ void itemview_formaction::prepare() {
 				render_width -= 5; 	
 		}
 
-		std::tr1::shared_ptr<rss_item> item = feed->get_item_by_guid(guid);
+		std::tr1::shared_ptr<rss_item> item = get_item();
+		if (!item)
+			return;
 		listformatter listfmt;
 
 		std::tr1::shared_ptr<rss_feed> feedptr = item->get_feedptr();
@@ -146,7 +148,9 @@ void itemview_formaction::prepare() {
 }
 
 void itemview_formaction::process_operation(operation op, bool automatic, std::vector<std::string> * args) {
-	std::tr1::shared_ptr<rss_item> item = feed->get_item_by_guid(guid);
+	std::tr1::shared_ptr<rss_item> item = get_item();
+	if (!item)
+		return;
 	bool hardquit = false;
 
 	/*
@@ -435,7 +439,9 @@ void itemview_formaction::handle_cmdline(const std::string& cmd) {
 	if (tokens.size() > 0) {
 		if (tokens[0] == "save" && tokens.size() >= 2) {
 			std::string filename = utils::resolve_tilde(tokens[1]);
-			std::tr1::shared_ptr<rss_item> item = feed->get_item_by_guid(guid);
+			std::tr1::shared_ptr<rss_item> item = get_item();
+			if (!item)
+				return;
 
 			if (filename == "") {
 				v->show_error(_("Aborted saving."));
@@ -457,7 +463,9 @@ void itemview_formaction::handle_cmdline(const std::string& cmd) {
 void itemview_formaction::finished_qna(operation op) {
 	formaction::finished_qna(op); // important!
 
-	std::tr1::shared_ptr<rss_item> item = feed->get_item_by_guid(guid);
+	std::tr1::shared_ptr<rss_item> item = get_item();
+	if (!item)
+		return;
 
 	switch (op) {
 		case OP_INT_EDITFLAGS_END:
@@ -472,7 +480,7 @@ void itemview_formaction::finished_qna(operation op) {
 		case OP_PIPE_TO: {
 				std::string cmd = qna_responses[0];
 				std::ostringstream ostr;
-				v->get_ctrl()->write_item(feed->get_item_by_guid(guid), ostr);
+				v->get_ctrl()->write_item(item, ostr);
 				v->push_empty_formaction();
 				stfl::reset();
 				FILE * f = popen(cmd.c_str(), "w");
@@ -563,9 +571,25 @@ void itemview_formaction::update_percent() {
 	}
 }
 
+/*
+ * the article may have vanished from the feed since the view was opened
+ * (e.g. by a reload). There is nothing left to show then, so the view is
+ * closed and an empty pointer is returned.
+ */
+std::tr1::shared_ptr<rss_item> itemview_formaction::get_item() {
+	std::tr1::shared_ptr<rss_item> item = feed->get_item_by_guid(guid);
+	if (!item) {
+		LOG(LOG_WARN, "itemview_formaction::get_item: article `%s' is gone", guid.c_str());
+		v->pop_current_formaction();
+		v->show_error(_("Article is no longer available."));
+	}
+	return item;
+}
+
 std::string itemview_formaction::title() {
+	// not get_item(): this view needn't be the current one here
 	std::tr1::shared_ptr<rss_item> item = feed->get_item_by_guid(guid);
-	return utils::strprintf(_("Article - %s"), item->title().c_str());
+	return utils::strprintf(_("Article - %s"), item ? item->title().c_str() : "");
 }
 
 void itemview_formaction::set_highlightphrase(const std::string& text) {
@@ -0,0 +1,240 @@
+#include <literalscanner.h>
+
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <deque>
+
+namespace newsbeuter {
+
+literal_scanner::literal_scanner() : classes(1), transitions(1, 0), outputs(1), literal_count(0) {
+	memset(char_class, 0, sizeof(char_class));
+}
+
+void literal_scanner::build(const std::vector<std::string>& literals) {
+	literal_count = literals.size();
+
+	// upper and lower case letters share a class, all other characters that
+	// don't appear in the literals share class 0
+	memset(char_class, 0, sizeof(char_class));
+	classes = 1;
+	for (std::vector<std::string>::const_iterator it=literals.begin();it!=literals.end();++it) {
+		for (std::string::const_iterator jt=it->begin();jt!=it->end();++jt) {
+			unsigned char c = to_lower(*jt);
+			if (char_class[c] == 0) {
+				char_class[c] = classes;
+				if (c >= 'a' && c <= 'z')
+					char_class[c - ('a' - 'A')] = classes;
+				classes++;
+			}
+		}
+	}
+
+	// the trie of all literals; 0 is the root and doubles as "no transition"
+	transitions.assign(classes, 0);
+	outputs.assign(1, std::vector<unsigned int>());
+	for (unsigned int i=0;i<literals.size();++i) {
+		if (literals[i].empty())
+			continue;
+		unsigned int state = 0;
+		for (std::string::const_iterator jt=literals[i].begin();jt!=literals[i].end();++jt) {
+			unsigned int& next = transitions[state * classes + char_class[static_cast<unsigned char>(*jt)]];
+			if (next == 0) {
+				next = outputs.size();
+				outputs.push_back(std::vector<unsigned int>());
+				transitions.resize(transitions.size() + classes, 0);
+			}
+			state = transitions[state * classes + char_class[static_cast<unsigned char>(*jt)]];
+		}
+		outputs[state].push_back(i);
+	}
+
+	/*
+	 * breadth-first, every missing transition is replaced by the one of the
+	 * state for the longest proper suffix (the failure link), so that
+	 * scanning never needs to backtrack.
+	 */
+	std::vector<unsigned int> fail(outputs.size(), 0);
+	std::deque<unsigned int> queue;
+	for (unsigned int c=0;c<classes;++c) {
+		if (transitions[c] != 0)
+			queue.push_back(transitions[c]);
+	}
+	while (!queue.empty()) {
+		unsigned int state = queue.front();
+		queue.pop_front();
+		const std::vector<unsigned int>& inherited = outputs[fail[state]];
+		outputs[state].insert(outputs[state].end(), inherited.begin(), inherited.end());
+		for (unsigned int c=0;c<classes;++c) {
+			unsigned int& next = transitions[state * classes + c];
+			unsigned int fallback = transitions[fail[state] * classes + c];
+			if (next != 0) {
+				fail[next] = fallback;
+				queue.push_back(next);
+			} else {
+				next = fallback;
+			}
+		}
+	}
+}
+
+void literal_scanner::scan(const std::string& text, std::vector<bool>& found) const {
+	found.assign(literal_count, false);
+	unsigned int state = 0;
+	for (std::string::const_iterator it=text.begin();it!=text.end();++it) {
+		state = transitions[state * classes + char_class[static_cast<unsigned char>(*it)]];
+		const std::vector<unsigned int>& out = outputs[state];
+		for (std::vector<unsigned int>::const_iterator jt=out.begin();jt!=out.end();++jt) {
+			found[*jt] = true;
+		}
+	}
+}
+
+/*
+ * The regular expressions are compiled with REG_ICASE, so the literals are
+ * matched case-insensitively. Only ASCII characters are taken into a
+ * literal, and 'i' and 's' aren't either, as they also match non-ASCII
+ * characters in UTF-8 locales (dotless i and long s).
+ */
+static bool literal_char(char c) {
+	if (c & 0x80)
+		return false;
+	char l = literal_scanner::to_lower(c);
+	return l != 'i' && l != 's';
+}
+
+/*
+ * skips a sequence of quantifiers at rx[pos] and returns whether any of them
+ * allows zero repetitions of the preceding atom.
+ */
+static bool skip_quantifiers(const std::string& rx, unsigned int& pos, bool& quantified) {
+	bool optional = false;
+	quantified = false;
+	while (pos < rx.size()) {
+		char c = rx[pos];
+		if (c == '*' || c == '?') {
+			optional = true;
+		} else if (c == '{') {
+			std::string::size_type end = rx.find('}', pos);
+			if (end == std::string::npos)
+				end = rx.size() - 1;
+			if (strtol(rx.c_str() + pos + 1, NULL, 10) <= 0)
+				optional = true;
+			pos = end;
+		} else if (c != '+') {
+			break;
+		}
+		quantified = true;
+		++pos;
+	}
+	return optional;
+}
+
+// skips the bracket expression that starts at rx[pos]
+static unsigned int skip_bracket(const std::string& rx, unsigned int pos) {
+	++pos;
+	if (pos < rx.size() && rx[pos] == '^')
+		++pos;
+	if (pos < rx.size() && rx[pos] == ']')
+		++pos;
+	while (pos < rx.size() && rx[pos] != ']') {
+		if (rx[pos] == '[' && pos + 1 < rx.size() && (rx[pos+1] == ':' || rx[pos+1] == '.' || rx[pos+1] == '=')) {
+			char delim[] = { rx[pos+1], ']', 0 };
+			std::string::size_type end = rx.find(delim, pos + 2);
+			if (end == std::string::npos)
+				return rx.size();
+			pos = end + 2;
+		} else {
+			++pos;
+		}
+	}
+	return pos + 1;
+}
+
+// skips the parenthesized group that starts at rx[pos]
+static unsigned int skip_group(const std::string& rx, unsigned int pos) {
+	unsigned int depth = 0;
+	while (pos < rx.size()) {
+		switch (rx[pos]) {
+			case '\\':
+				pos += 2;
+				continue;
+			case '[':
+				pos = skip_bracket(rx, pos);
+				continue;
+			case '(':
+				++depth;
+				break;
+			case ')':
+				if (--depth == 0)
+					return pos + 1;
+				break;
+		}
+		++pos;
+	}
+	return pos;
+}
+
+std::string literal_scanner::required_literal(const std::string& rx) {
+	std::string best, current;
+	unsigned int pos = 0;
+	while (pos < rx.size()) {
+		char c = rx[pos];
+		bool literal = false;
+		switch (c) {
+			case '|':
+				// any of the alternatives may match
+				return "";
+			case '(':
+				pos = skip_group(rx, pos);
+				break;
+			case '[':
+				pos = skip_bracket(rx, pos);
+				break;
+			case '\\':
+				if (pos + 1 >= rx.size()) {
+					pos = rx.size();
+					break;
+				}
+				c = rx[pos+1];
+				// GNU extensions like \w and \<, and back-references
+				literal = !isalnum(static_cast<unsigned char>(c)) && c != '<' && c != '>' && c != '`' && c != '\'';
+				pos += 2;
+				break;
+			case '.':
+			case '^':
+			case '$':
+			case ')':
+			case '*':
+			case '+':
+			case '?':
+				++pos;
+				break;
+			case '{': {
+					std::string::size_type end = rx.find('}', pos);
+					pos = (end == std::string::npos) ? rx.size() : end + 1;
+				}
+				break;
+			default:
+				literal = true;
+				++pos;
+				break;
+		}
+
+		bool quantified;
+		bool optional = skip_quantifiers(rx, pos, quantified);
+		if (literal && literal_char(c) && !optional)
+			current.append(1, literal_scanner::to_lower(c));
+		if (!literal || !literal_char(c) || quantified) {
+			if (current.length() > best.length())
+				best = current;
+			current.clear();
+		}
+	}
+	if (current.length() > best.length())
+		best = current;
+	return best;
+}
+
+
+}
@@ -2,19 +2,246 @@
 #include <logger.h>
 #include <utils.h>
 #include <exceptions.h>
+#include <workerpool.h>
+#include <literalscanner.h>
+#include <mutex.h>
 
 #include <sys/time.h>
 #include <regex.h>
 #include <ctime>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
 #include <cassert>
-#include <sstream>
 #include <vector>
+#include <tr1/unordered_map>
 
 namespace newsbeuter {
 
 matchable::matchable() { }
 matchable::~matchable() { }
 
+bool matchable::has_attribute(attribute_id /* id */, const std::string& attribname) {
+	return has_attribute(attribname);
+}
+
+std::string matchable::get_attribute(attribute_id /* id */, const std::string& attribname) {
+	return get_attribute(attribname);
+}
+
+static int parse_int(const char * str);
+
+long matchable::get_attribute_int(attribute_id id, const std::string& attribname) {
+	return parse_int(get_attribute(id, attribname).c_str());
+}
+
+time_t matchable::get_attribute_time(attribute_id /* id */, const std::string& /* attribname */) {
+	return 0;
+}
+
+const std::string& matchable::get_attribute_ref(attribute_id id, const std::string& attribname, std::string& buf) {
+	buf = get_attribute(id, attribname);
+	return buf;
+}
+
+const std::tr1::unordered_set<std::string> * matchable::get_attribute_words(attribute_id /* id */, const std::string& /* attribname */) {
+	return NULL;
+}
+
+unsigned long matchable::attribute_generation() {
+	return 0;
+}
+
+static const struct {
+	const char * name;
+	attribute_id id;
+} attribute_names[] = {
+	{ "title", ATTR_TITLE },
+	{ "link", ATTR_LINK },
+	{ "author", ATTR_AUTHOR },
+	{ "content", ATTR_CONTENT },
+	{ "date", ATTR_DATE },
+	{ "guid", ATTR_GUID },
+	{ "unread", ATTR_UNREAD },
+	{ "enclosure_url", ATTR_ENCLOSURE_URL },
+	{ "enclosure_type", ATTR_ENCLOSURE_TYPE },
+	{ "flags", ATTR_FLAGS },
+	{ "age", ATTR_AGE },
+	{ "articleindex", ATTR_ARTICLEINDEX },
+	{ "feedtitle", ATTR_FEEDTITLE },
+	{ "description", ATTR_DESCRIPTION },
+	{ "feedlink", ATTR_FEEDLINK },
+	{ "feeddate", ATTR_FEEDDATE },
+	{ "rssurl", ATTR_RSSURL },
+	{ "unread_count", ATTR_UNREAD_COUNT },
+	{ "total_count", ATTR_TOTAL_COUNT },
+	{ "tags", ATTR_TAGS },
+	{ "feedindex", ATTR_FEEDINDEX },
+	{ NULL, ATTR_UNKNOWN }
+};
+
+attribute_id matchable::get_attribute_id(const std::string& attribname) {
+	for (unsigned int i=0;attribute_names[i].name;++i) {
+		if (attribname == attribute_names[i].name)
+			return attribute_names[i].id;
+	}
+	return ATTR_UNKNOWN;
+}
+
+/*
+ * converts a number the same way as reading an int from a std::istringstream
+ * does: leading whitespace is skipped, garbage yields 0 and values that
+ * don't fit are clamped.
+ */
+static int parse_int(const char * str) {
+	char * end;
+	long l = strtol(str, &end, 10);
+	if (end == str)
+		return 0;
+	if (l > INT_MAX)
+		return INT_MAX;
+	if (l < INT_MIN)
+		return INT_MIN;
+	return l;
+}
+
+/*
+ * the numeric operators compare ints, so get_attribute_int() results are
+ * clamped the same way as parse_int() does it.
+ */
+static int get_int(matchable * item, const matcher_instruction& in) {
+	long l = item->get_attribute_int(in.id, in.name);
+	if (l > INT_MAX)
+		return INT_MAX;
+	if (l < INT_MIN)
+		return INT_MIN;
+	return l;
+}
+
+static void free_regex(regex_t * r) {
+	regfree(r);
+	delete r;
+}
+
+/*
+ * Most regular expressions in filters contain a literal string that every
+ * match has to contain, e.g. "foo" in "foo(bar)?". If the attribute doesn't
+ * contain it, regexec() can't match either, and a substring search is a lot
+ * cheaper than regexec(), especially on the article content.
+ *
+ * The literal is searched for by looking for its rarest character first,
+ * as memchr() is a lot faster than comparing at every position.
+ */
+static unsigned int choose_pivot(const std::string& literal) {
+	static const char letters[] = "etaonrhldcumfpgwybvkxjqz"; // most frequent in English text first
+	unsigned int pivot = 0;
+	int best = -1;
+	for (unsigned int i=0;i<literal.length();++i) {
+		int rarity;
+		const char * l = strchr(letters, literal[i]);
+		if (literal[i] == ' ')
+			rarity = 0;
+		else if (l)
+			rarity = 1 + (l - letters);
+		else
+			rarity = 20; // digits and punctuation; they are found with only one memchr()
+		if (rarity > best) {
+			best = rarity;
+			pivot = i;
+		}
+	}
+	return pivot;
+}
+
+static bool literal_at(const char * text, const std::string& literal) {
+	for (unsigned int i=0;i<literal.length();++i) {
+		if (literal_scanner::to_lower(text[i]) != literal[i])
+			return false;
+	}
+	return true;
+}
+
+static bool contains_literal(const std::string& text, const matcher_instruction& in) {
+	const std::string& literal = in.rx_literal;
+	if (text.length() < literal.length())
+		return false;
+
+	// the pivot character can be anywhere in [first, last]
+	const char * first = text.data() + in.rx_pivot;
+	const char * last = text.data() + text.length() - (literal.length() - in.rx_pivot);
+	char lower = literal[in.rx_pivot];
+	char upper = (lower >= 'a' && lower <= 'z') ? lower - ('a' - 'A') : lower;
+
+	const char * l = static_cast<const char *>(memchr(first, lower, last - first + 1));
+	const char * u = (upper != lower) ? static_cast<const char *>(memchr(first, upper, last - first + 1)) : NULL;
+	while (l || u) {
+		const char * p = (!u || (l && l < u)) ? l : u;
+		if (literal_at(p - in.rx_pivot, literal))
+			return true;
+		if (p == l)
+			l = (p < last) ? static_cast<const char *>(memchr(p + 1, lower, last - p)) : NULL;
+		else
+			u = (p < last) ? static_cast<const char *>(memchr(p + 1, upper, last - p)) : NULL;
+	}
+	return false;
+}
+
+/*
+ * finds word as one of the space-separated words of text, without splitting
+ * text up. Words are never empty and never contain spaces, so such a word
+ * can't be found.
+ */
+static bool contains_word(const std::string& text, const std::string& word) {
+	if (word.empty() || word.find(' ') != std::string::npos)
+		return false;
+	std::string::size_type pos = 0;
+	while ((pos = text.find(word, pos)) != std::string::npos) {
+		std::string::size_type end = pos + word.length();
+		if ((pos == 0 || text[pos-1] == ' ') && (end == text.length() || text[end] == ' '))
+			return true;
+		pos = text.find(' ', end);
+		if (pos == std::string::npos)
+			break;
+	}
+	return false;
+}
+
+/*
+ * The same items are matched by the same expressions over and over again,
+ * e.g. whenever a list is redrawn. The memo remembers the result for every
+ * item together with the item's attribute_generation(), so an item is only
+ * matched again after it changed. It may be shared by copies of a matcher
+ * and by several threads, so it has a mutex of its own. Items that were
+ * deleted leave stale entries behind (their generations are never used
+ * again), which is why the memo is emptied when it gets too large.
+ */
+struct matcher_memo {
+	mutex mtx;
+	std::tr1::unordered_map<matchable *, std::pair<unsigned long, bool> > results;
+};
+
+#define MAX_MEMO_ENTRIES 65536
+
+static bool memo_lookup(matcher_memo * memo, matchable * item, unsigned long generation, bool& result) {
+	std::tr1::unordered_map<matchable *, std::pair<unsigned long, bool> >::iterator it = memo->results.find(item);
+	if (it == memo->results.end() || it->second.first != generation)
+		return false;
+	result = it->second.second;
+	return true;
+}
+
+// makes sure that count more entries fit, allowing at least twice as many as in the current batch
+static void memo_make_room(matcher_memo * memo, unsigned int count, unsigned int batch) {
+	if (memo->results.size() + count > std::max<unsigned int>(MAX_MEMO_ENTRIES, 2 * batch))
+		memo->results.clear();
+}
+
+static void memo_store(matcher_memo * memo, matchable * item, unsigned long generation, bool result) {
+	memo->results[item] = std::make_pair(generation, result);
+}
+
 matcher::matcher() { }
 
 matcher::matcher(const std::string& expr) : exp(expr) {
@@ -34,6 +261,7 @@ bool matcher::parse(const std::string& expr) {
 	if (!b) {
 		errmsg = utils::wstr2str(p.get_error());
 	}
+	compile();
 
 	gettimeofday(&tv2, NULL);
 	unsigned long diff = (((tv2.tv_sec - tv1.tv_sec) * 1000000) + tv2.tv_usec) - tv1.tv_usec;
@@ -42,6 +270,327 @@ bool matcher::parse(const std::string& expr) {
 	return b;
 }
 
+/*
+ * the parse tree, with chains of the same logical operator flattened (as
+ * "a and (b and c)" is evaluated just like "(a and b) and c"), so that the
+ * operands of a chain can be reordered as a whole.
+ */
+struct matcher_node {
+	matcher_node() : op(LOGOP_INVALID), cost(0), selectivity(1) { }
+	int op;
+	matcher_instruction leaf;
+	std::vector<matcher_node> children; // operands of LOGOP_AND/LOGOP_OR
+	double cost; // estimated cost of evaluating the node
+	double selectivity; // estimated probability that it matches
+};
+
+static void compile_matchexpr(expression * e, matcher_instruction& in);
+
+static void build_node(expression * e, matcher_node& node);
+
+static void add_operands(expression * e, matcher_node& node) {
+	if (e && e->op == node.op) {
+		add_operands(e->l, node);
+		add_operands(e->r, node);
+	} else {
+		node.children.push_back(matcher_node());
+		build_node(e, node.children.back());
+	}
+}
+
+static void build_node(expression * e, matcher_node& node) {
+	if (!e) {
+		// an empty subexpression always matches
+		return;
+	}
+	node.op = e->op;
+	switch (e->op) {
+		case LOGOP_AND:
+		case LOGOP_OR:
+			add_operands(e->l, node);
+			add_operands(e->r, node);
+			break;
+		default:
+			compile_matchexpr(e, node.leaf);
+			break;
+	}
+}
+
+/*
+ * every operand of a chain is followed by a jump to the end of the chain
+ * that is taken as soon as the operand decides the result.
+ */
+static void emit(const matcher_node& node, std::vector<matcher_instruction>& prog) {
+	if (node.children.empty()) {
+		prog.push_back(node.leaf);
+		return;
+	}
+	std::vector<unsigned int> jumps;
+	for (unsigned int i=0;i<node.children.size();++i) {
+		if (i > 0) {
+			jumps.push_back(prog.size());
+			matcher_instruction in;
+			in.op = node.op;
+			prog.push_back(in);
+		}
+		emit(node.children[i], prog);
+	}
+	for (std::vector<unsigned int>::iterator it=jumps.begin();it!=jumps.end();++it) {
+		prog[*it].jump = prog.size();
+	}
+}
+
+/*
+ * rough relative costs: flags and numbers are cheap, dates need to be
+ * formatted, strings need to be compared, and some attributes (and all
+ * attributes of unknown matchables) are built on every access. The content
+ * is by far the longest string.
+ */
+static double attribute_cost(attribute_id id) {
+	switch (id) {
+		case ATTR_UNREAD:
+		case ATTR_FLAGS:
+		case ATTR_AGE:
+		case ATTR_ARTICLEINDEX:
+		case ATTR_UNREAD_COUNT:
+		case ATTR_TOTAL_COUNT:
+		case ATTR_FEEDINDEX:
+			return 1;
+		case ATTR_DATE:
+		case ATTR_FEEDDATE:
+			return 4;
+		case ATTR_TITLE:
+		case ATTR_LINK:
+		case ATTR_AUTHOR:
+		case ATTR_GUID:
+		case ATTR_ENCLOSURE_URL:
+		case ATTR_ENCLOSURE_TYPE:
+		case ATTR_FEEDLINK:
+		case ATTR_RSSURL:
+			return 8;
+		case ATTR_CONTENT:
+			return 64;
+		default:
+			return 16;
+	}
+}
+
+static void estimate_leaf(matcher_node& node) {
+	double cost = attribute_cost(node.leaf.id);
+	switch (node.op) {
+		case LOGOP_INVALID:
+			node.cost = 0;
+			node.selectivity = 1;
+			break;
+		case MATCHOP_EQ:
+			node.cost = cost;
+			node.selectivity = 0.2;
+			break;
+		case MATCHOP_NE:
+			node.cost = cost;
+			node.selectivity = 0.8;
+			break;
+		case MATCHOP_LT:
+		case MATCHOP_GT:
+		case MATCHOP_LE:
+		case MATCHOP_GE:
+			node.cost = cost;
+			node.selectivity = 0.5;
+			break;
+		case MATCHOP_BETWEEN:
+			node.cost = cost;
+			node.selectivity = 0.3;
+			break;
+		case MATCHOP_CONTAINS:
+			// tags are looked up in the feed's set of tags
+			node.cost = node.leaf.id == ATTR_TAGS ? 1 : cost * 2;
+			node.selectivity = 0.2;
+			break;
+		case MATCHOP_CONTAINSNOT:
+			node.cost = node.leaf.id == ATTR_TAGS ? 1 : cost * 2;
+			node.selectivity = 0.8;
+			break;
+		case MATCHOP_RXEQ:
+			node.cost = cost * 8;
+			node.selectivity = 0.2;
+			break;
+		case MATCHOP_RXNE:
+			node.cost = cost * 8;
+			node.selectivity = 0.8;
+			break;
+		default:
+			node.cost = cost;
+			node.selectivity = 0.5;
+			break;
+	}
+}
+
+/*
+ * an operand should come first if it's cheap and likely to decide the
+ * result, i.e. to not match in an "and" chain or to match in an "or" chain.
+ */
+static double operand_rank(const matcher_node& node, int op) {
+	double decides = (op == LOGOP_AND) ? 1 - node.selectivity : node.selectivity;
+	return node.cost / (decides + 0.000001);
+}
+
+struct cheaper_operand {
+	cheaper_operand(const std::vector<matcher_node>& c, int o) : children(c), op(o) { }
+	bool operator()(unsigned int a, unsigned int b) const {
+		return operand_rank(children[a], op) < operand_rank(children[b], op);
+	}
+	const std::vector<matcher_node>& children;
+	int op;
+};
+
+/*
+ * sorts the operands of all chains by their rank and estimates cost and
+ * selectivity of every node. Returns whether any operands were moved.
+ */
+static bool optimize(matcher_node& node) {
+	if (node.children.empty()) {
+		estimate_leaf(node);
+		return false;
+	}
+
+	bool changed = false;
+	for (std::vector<matcher_node>::iterator it=node.children.begin();it!=node.children.end();++it) {
+		if (optimize(*it))
+			changed = true;
+	}
+
+	std::vector<unsigned int> order;
+	for (unsigned int i=0;i<node.children.size();++i)
+		order.push_back(i);
+	std::stable_sort(order.begin(), order.end(), cheaper_operand(node.children, node.op));
+	for (unsigned int i=0;i<order.size();++i) {
+		if (order[i] != i) {
+			std::vector<matcher_node> children;
+			for (std::vector<unsigned int>::iterator it=order.begin();it!=order.end();++it)
+				children.push_back(node.children[*it]);
+			node.children.swap(children);
+			changed = true;
+			break;
+		}
+	}
+
+	// an operand is only evaluated if all operands before it didn't decide the result
+	double undecided = 1;
+	node.cost = 0;
+	for (std::vector<matcher_node>::iterator it=node.children.begin();it!=node.children.end();++it) {
+		node.cost += undecided * it->cost;
+		undecided *= (node.op == LOGOP_AND) ? it->selectivity : 1 - it->selectivity;
+	}
+	node.selectivity = (node.op == LOGOP_AND) ? undecided : 1 - undecided;
+
+	return changed;
+}
+
+/*
+ * collects the attributes of all leaves. Returns false if an instruction
+ * can fail for any item, i.e. if it contains an invalid regular expression.
+ */
+static bool collect_attributes(const matcher_node& node, std::vector<std::pair<attribute_id, std::string> >& attributes) {
+	if (node.children.empty()) {
+		if (node.op == LOGOP_INVALID)
+			return true;
+		if ((node.op == MATCHOP_RXEQ || node.op == MATCHOP_RXNE) && !node.leaf.regex)
+			return false;
+		std::pair<attribute_id, std::string> attr(node.leaf.id, node.leaf.name);
+		if (std::find(attributes.begin(), attributes.end(), attr) == attributes.end())
+			attributes.push_back(attr);
+		return true;
+	}
+	for (std::vector<matcher_node>::const_iterator it=node.children.begin();it!=node.children.end();++it) {
+		if (!collect_attributes(*it, attributes))
+			return false;
+	}
+	return true;
+}
+
+void matcher::compile() {
+	program.clear();
+	optimized.clear();
+	checked_attributes.clear();
+	memo.reset();
+	if (!p.get_root())
+		return;
+
+	matcher_node root;
+	build_node(p.get_root(), root);
+	emit(root, program);
+
+	/*
+	 * Reordering the operands doesn't change whether an expression matches,
+	 * but it may change whether (and which) error is thrown, because the
+	 * erroneous operand may be skipped in one order but not in the other.
+	 * Therefore, the optimized program is only used for items where no
+	 * instruction can fail, see can_reorder().
+	 */
+	if (optimize(root) && collect_attributes(root, checked_attributes)) {
+		emit(root, optimized);
+		LOG(LOG_DEBUG, "matcher::compile: reordered operands, estimated cost %f", root.cost);
+	} else {
+		checked_attributes.clear();
+	}
+
+	if (!uses_attribute(ATTR_AGE))
+		memo.reset(new matcher_memo);
+}
+
+static void compile_matchexpr(expression * e, matcher_instruction& in) {
+	in.op = e->op;
+	in.name = e->name;
+	in.id = matchable::get_attribute_id(e->name);
+	in.literal = e->literal;
+
+	switch (e->op) {
+		case MATCHOP_LT:
+		case MATCHOP_GT:
+		case MATCHOP_LE:
+		case MATCHOP_GE:
+			in.ilit = parse_int(e->literal.c_str());
+			break;
+		case MATCHOP_BETWEEN: {
+				std::vector<std::string> lit = utils::tokenize(e->literal, ":");
+				if (lit.size() == 2) {
+					in.has_range = true;
+					in.ilit = parse_int(lit[0].c_str());
+					in.ilit2 = parse_int(lit[1].c_str());
+					if (in.ilit > in.ilit2)
+						std::swap(in.ilit, in.ilit2);
+				}
+			}
+			break;
+		case MATCHOP_RXEQ:
+		case MATCHOP_RXNE: {
+				regex_t * r = new regex_t;
+				int err;
+				if ((err = regcomp(r, e->literal.c_str(), REG_EXTENDED | REG_ICASE | REG_NOSUB)) != 0) {
+					char buf[1024];
+					regerror(err, r, buf, sizeof(buf));
+					in.regex_error = buf;
+					delete r;
+				} else {
+					in.regex.reset(r, free_regex);
+					in.rx_literal = literal_scanner::required_literal(e->literal);
+					in.rx_pivot = choose_pivot(in.rx_literal);
+				}
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+bool matcher::can_reorder(matchable * item) {
+	for (std::vector<std::pair<attribute_id, std::string> >::iterator it=checked_attributes.begin();it!=checked_attributes.end();++it) {
+		if (!item->has_attribute(it->first, it->second))
+			return false;
+	}
+	return true;
+}
+
 bool matcher::matches(matchable* item) {
 	/*
 	 * with this method, every class that is derived from matchable can be
@@ -56,148 +605,273 @@ bool matcher::matches(matchable* item) {
 	 * The whole matching code is speed-critical, as the matching happens on a
 	 * lot of different occassions, and slow matching can be easily measured
 	 * (and felt by the user) on slow computers with a lot of items to match.
+	 * That's why the expression is compiled by parse() and only the compiled
+	 * program is run here, and results are reused while items don't change.
+	 * For the same reason, single matches aren't timed (scope_measure would
+	 * cost more than the match itself); the callers measure their loops
+	 * instead.
 	 */
-	bool retval = false; 
-	if (item) { 
-		scope_measure m1("matcher::matches");
-		retval = matches_r(p.get_root(), item);
-	}
-	return retval;
-}
-
-bool matcher::matchop_lt(expression * e, matchable * item) {
-	if (!item->has_attribute(e->name))
-		throw matcherexception(matcherexception::ATTRIB_UNAVAIL, e->name);
-	std::istringstream islit(e->literal);
-	std::istringstream isatt(item->get_attribute(e->name));
-	int ilit, iatt;
-	islit >> ilit;
-	isatt >> iatt;
-	return iatt < ilit;
-}
-
-bool matcher::matchop_between(expression * e, matchable * item) {
-	if (!item->has_attribute(e->name))
-		throw matcherexception(matcherexception::ATTRIB_UNAVAIL, e->name);
-	std::vector<std::string> lit = utils::tokenize(e->literal, ":");
-	std::istringstream isatt(item->get_attribute(e->name));
-	int att;
-	isatt >> att;
-	if (lit.size() != 2)
+	if (!item)
 		return false;
-	std::istringstream is1(lit[0]), is2(lit[1]);
-	int i1, i2, tmp;
-	is1 >> i1;
-	is2 >> i2;
-	if (i1 > i2) {
-		tmp = i1;
-		i1 = i2;
-		i2 = tmp;
-	}
-	return (att >= i1 && att <= i2);
-}
-
-bool matcher::matchop_gt(expression * e, matchable * item) {
-	if (!item->has_attribute(e->name))
-		throw matcherexception(matcherexception::ATTRIB_UNAVAIL, e->name);
-	std::istringstream islit(e->literal);
-	std::istringstream isatt(item->get_attribute(e->name));
-	int ilit, iatt;
-	islit >> ilit;
-	isatt >> iatt;
-	return iatt > ilit;
-}
-
-bool matcher::matchop_rxeq(expression * e, matchable * item) {
-	if (!item->has_attribute(e->name))
-		throw matcherexception(matcherexception::ATTRIB_UNAVAIL, e->name);
-	if (!e->regex) {
-		e->regex = new regex_t;
-		int err;
-		if ((err = regcomp(e->regex, e->literal.c_str(), REG_EXTENDED | REG_ICASE | REG_NOSUB)) != 0) {
-			char buf[1024];
-			regerror(err, e->regex, buf, sizeof(buf));
-			throw matcherexception(matcherexception::INVALID_REGEX, e->literal, buf);
-		}
+
+	unsigned long generation = memo ? item->attribute_generation() : 0;
+	if (generation != 0) {
+		scope_mutex lock(&memo->mtx);
+		bool result;
+		if (memo_lookup(memo.get(), item, generation, result))
+			return result;
 	}
-	if (regexec(e->regex, item->get_attribute(e->name).c_str(), 0, NULL, 0)==0)
-		return true;
-	return false;
+
+	bool result = evaluate(item);
+
+	if (generation != 0) {
+		scope_mutex lock(&memo->mtx);
+		memo_make_room(memo.get(), 1, 1);
+		memo_store(memo.get(), item, generation, result);
+	}
+	return result;
 }
 
-bool matcher::matchop_cont(expression * e, matchable * item) {
-	if (!item->has_attribute(e->name))
-		throw matcherexception(matcherexception::ATTRIB_UNAVAIL, e->name);
-	std::vector<std::string> elements = utils::tokenize(item->get_attribute(e->name), " ");
-	std::string literal = e->literal;
-	for (std::vector<std::string>::iterator it=elements.begin();it!=elements.end();++it) {
-		if (literal == *it) {
-			return true;
+bool matcher::evaluate(matchable * item) {
+	if (!item)
+		return false;
+	if (optimized.size() > 0 && can_reorder(item))
+		return run(optimized, item);
+	return run(program, item);
+}
+
+/*
+ * evaluate() doesn't modify the matcher (the compiled regular expressions
+ * are only read by regexec()), so one matcher can be used by several
+ * threads. Every match_job matches a consecutive chunk of the items that
+ * aren't in the memo.
+ */
+struct match_job : public worker_job {
+	match_job(matcher * mt, const std::vector<matchable *>& i, const std::vector<unsigned int>& p, std::vector<char>& r, unsigned int b, unsigned int e)
+		: m(mt), items(i), pending(p), result(r), begin(b), end(e) { }
+	virtual void run() {
+		for (unsigned int i=begin;i<end;++i) {
+			try {
+				result[pending[i]] = m->evaluate(items[pending[i]]) ? 1 : 0;
+			} catch (const matcherexception& e) {
+				error.reset(new matcherexception(e));
+				return;
+			}
+		}
+	}
+	matcher * m;
+	const std::vector<matchable *>& items;
+	const std::vector<unsigned int>& pending;
+	std::vector<char>& result;
+	unsigned int begin, end;
+	std::tr1::shared_ptr<matcherexception> error;
+};
+
+// below this, handing the items to other threads costs more than it saves
+#define MIN_ITEMS_PER_JOB 512
+
+void matcher::matches_all(const std::vector<matchable *>& items, std::vector<char>& result) {
+	result.assign(items.size(), 0);
+
+	// the memo is looked up and updated all at once, so that the threads
+	// don't need to lock it for every item
+	std::vector<unsigned long> generations(items.size(), 0);
+	std::vector<unsigned int> pending;
+	if (memo) {
+		for (unsigned int i=0;i<items.size();++i) {
+			if (items[i])
+				generations[i] = items[i]->attribute_generation();
 		}
+		scope_mutex lock(&memo->mtx);
+		for (unsigned int i=0;i<items.size();++i) {
+			bool r;
+			if (generations[i] != 0 && memo_lookup(memo.get(), items[i], generations[i], r))
+				result[i] = r ? 1 : 0;
+			else
+				pending.push_back(i);
+		}
+	} else {
+		for (unsigned int i=0;i<items.size();++i)
+			pending.push_back(i);
 	}
+
+	worker_pool& pool = worker_pool::get();
+	// a few jobs per thread, as the cost of matching differs between items
+	unsigned int jobcount = std::min<unsigned int>(pool.concurrency() * 4, pending.size() / MIN_ITEMS_PER_JOB);
+
+	if (jobcount <= 1) {
+		for (std::vector<unsigned int>::iterator it=pending.begin();it!=pending.end();++it) {
+			result[*it] = evaluate(items[*it]) ? 1 : 0;
+		}
+	} else {
+		std::vector<worker_job *> jobs;
+		unsigned int chunk = (pending.size() + jobcount - 1) / jobcount;
+		for (unsigned int begin=0;begin<pending.size();begin+=chunk) {
+			jobs.push_back(new match_job(this, items, pending, result, begin, std::min<unsigned int>(begin + chunk, pending.size())));
+		}
+		pool.run(jobs);
+
+		std::tr1::shared_ptr<matcherexception> error;
+		for (std::vector<worker_job *>::iterator it=jobs.begin();it!=jobs.end();++it) {
+			match_job * job = static_cast<match_job *>(*it);
+			if (!error && job->error)
+				error = job->error;
+			delete job;
+		}
+		if (error)
+			throw *error;
+	}
+
+	if (memo) {
+		scope_mutex lock(&memo->mtx);
+		memo_make_room(memo.get(), pending.size(), items.size());
+		for (std::vector<unsigned int>::iterator it=pending.begin();it!=pending.end();++it) {
+			if (generations[*it] != 0)
+				memo_store(memo.get(), items[*it], generations[*it], result[*it] != 0);
+		}
+	}
+}
+
+bool matcher::matchop_lt(const matcher_instruction& in, matchable * item) {
+	if (!item->has_attribute(in.id, in.name))
+		throw matcherexception(matcherexception::ATTRIB_UNAVAIL, in.name);
+	return get_int(item, in) < in.ilit;
+}
+
+bool matcher::matchop_between(const matcher_instruction& in, matchable * item) {
+	if (!item->has_attribute(in.id, in.name))
+		throw matcherexception(matcherexception::ATTRIB_UNAVAIL, in.name);
+	if (!in.has_range)
+		return false;
+	int att = get_int(item, in);
+	return (att >= in.ilit && att <= in.ilit2);
+}
+
+bool matcher::matchop_gt(const matcher_instruction& in, matchable * item) {
+	if (!item->has_attribute(in.id, in.name))
+		throw matcherexception(matcherexception::ATTRIB_UNAVAIL, in.name);
+	return get_int(item, in) > in.ilit;
+}
+
+bool matcher::matchop_rxeq(const matcher_instruction& in, matchable * item) {
+	if (!item->has_attribute(in.id, in.name))
+		throw matcherexception(matcherexception::ATTRIB_UNAVAIL, in.name);
+	if (!in.regex)
+		throw matcherexception(matcherexception::INVALID_REGEX, in.literal, in.regex_error);
+	std::string buf;
+	const std::string& text = item->get_attribute_ref(in.id, in.name, buf);
+	if (in.rx_literal.length() > 0 && !contains_literal(text, in))
+		return false;
+	if (regexec(in.regex.get(), text.c_str(), 0, NULL, 0)==0)
+		return true;
 	return false;
 }
 
-bool matcher::matchop_eq(expression * e, matchable * item) {
-	if (!item->has_attribute(e->name)) {
-		LOG(LOG_WARN, "matcher::matches_r: attribute %s not available", e->name.c_str());
-		throw matcherexception(matcherexception::ATTRIB_UNAVAIL, e->name);
+bool matcher::matchop_cont(const matcher_instruction& in, matchable * item) {
+	if (!item->has_attribute(in.id, in.name))
+		throw matcherexception(matcherexception::ATTRIB_UNAVAIL, in.name);
+	const std::tr1::unordered_set<std::string> * words = item->get_attribute_words(in.id, in.name);
+	if (words)
+		return words->find(in.literal) != words->end();
+	std::string buf;
+	return contains_word(item->get_attribute_ref(in.id, in.name, buf), in.literal);
+}
+
+bool matcher::matchop_eq(const matcher_instruction& in, matchable * item) {
+	if (!item->has_attribute(in.id, in.name)) {
+		LOG(LOG_WARN, "matcher::matchop_eq: attribute %s not available", in.name.c_str());
+		throw matcherexception(matcherexception::ATTRIB_UNAVAIL, in.name);
 	}
-	return (item->get_attribute(e->name)==e->literal);
+	std::string buf;
+	return (item->get_attribute_ref(in.id, in.name, buf)==in.literal);
 }
 
-bool matcher::matches_r(expression * e, matchable * item) {
-	if (e) {
-		switch (e->op) {
-			/* the operator "and" and "or" simply connect two different subexpressions */
+bool matcher::run(const std::vector<matcher_instruction>& prog, matchable * item) {
+	bool result = true; // an empty program always matches
+	unsigned int pc = 0;
+	while (pc < prog.size()) {
+		const matcher_instruction& in = prog[pc];
+		switch (in.op) {
+			/* "and" and "or" skip their right-hand side if the left-hand side already decided the result */
 			case LOGOP_AND:
-				return matches_r(e->l, item) && matches_r(e->r, item); // short-circuit evaulation in C -> short circuit evaluation in the filter language
+				if (!result) {
+					pc = in.jump;
+					continue;
+				}
+				break;
 
 			case LOGOP_OR:
-				return matches_r(e->l, item) || matches_r(e->r, item); // same here
+				if (result) {
+					pc = in.jump;
+					continue;
+				}
+				break;
+
+			case LOGOP_INVALID:
+				result = true;
+				break;
 
 			/* while the other operator connect an attribute with a value */
 			case MATCHOP_EQ:
-				return matchop_eq(e, item);
+				result = matchop_eq(in, item);
+				break;
 
 			case MATCHOP_NE:
-				return !matchop_eq(e, item);
+				result = !matchop_eq(in, item);
+				break;
 
 			case MATCHOP_LT:
-				return matchop_lt(e, item);
+				result = matchop_lt(in, item);
+				break;
 
 			case MATCHOP_BETWEEN:
-				return matchop_between(e, item);
+				result = matchop_between(in, item);
+				break;
 
 			case MATCHOP_GT:
-				return matchop_gt(e, item);
+				result = matchop_gt(in, item);
+				break;
 
 			case MATCHOP_LE:
-				return !matchop_gt(e, item);
+				result = !matchop_gt(in, item);
+				break;
 
 			case MATCHOP_GE:
-				return !matchop_lt(e, item);
+				result = !matchop_lt(in, item);
+				break;
 
 			case MATCHOP_RXEQ:
-				return matchop_rxeq(e, item);
+				result = matchop_rxeq(in, item);
+				break;
 
 			case MATCHOP_RXNE:
-				return !matchop_rxeq(e, item);
+				result = !matchop_rxeq(in, item);
+				break;
 
 			case MATCHOP_CONTAINS:
-				return matchop_cont(e, item);
+				result = matchop_cont(in, item);
+				break;
 
 			case MATCHOP_CONTAINSNOT:
-				return !matchop_cont(e, item);
+				result = !matchop_cont(in, item);
+				break;
 
 			default:
-				LOG(LOG_ERROR, "matcher::matches_r: invalid operator %d", e->op);
+				LOG(LOG_ERROR, "matcher::run: invalid operator %d", in.op);
 				assert(false); // that's an error condition
+				return false;
 		}
-		return false;
-	} else {
-		return true; // shouldn't happen
+		++pc;
 	}
+	return result;
+}
+
+bool matcher::uses_attribute(attribute_id id) const {
+	for (std::vector<matcher_instruction>::const_iterator it=program.begin();it!=program.end();++it) {
+		if (it->op != LOGOP_AND && it->op != LOGOP_OR && it->id == id)
+			return true;
+	}
+	return false;
 }
 
 const std::string& matcher::get_parse_error() {
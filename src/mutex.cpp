@@ -45,6 +45,30 @@ bool mutex::trylock() {
 	}
 }
 
+condition::condition() {
+	pthread_cond_init(&cond, NULL);
+}
+
+condition::~condition() {
+	pthread_cond_destroy(&cond);
+}
+
+void condition::wait(mutex * m) {
+	int rc = pthread_cond_wait(&cond, &m->mtx);
+	if (rc != 0) {
+		LOG(LOG_INFO, "condition::wait: wait returned %d", rc);
+		throw exception(rc);
+	}
+}
+
+void condition::signal() {
+	pthread_cond_signal(&cond);
+}
+
+void condition::broadcast() {
+	pthread_cond_broadcast(&cond);
+}
+
 scope_mutex::scope_mutex(mutex * m) : mtx(m) {
 	if (mtx) {
 		mtx->lock();
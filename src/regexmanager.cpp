@@ -78,8 +78,7 @@ void regexmanager::handle_action(const std::string& action, const std::vector<st
 		if (location != "all") {
 			LOG(LOG_DEBUG, "regexmanager::handle_action: adding rx = %s colorstr = %s to location %s",
 				params[1].c_str(), colorstr.c_str(), location.c_str());
-			locations[location].first.push_back(rx);
-			locations[location].second.push_back(colorstr);
+			add_regex(location, rx, params[1], colorstr);
 		} else {
 			delete rx;
 			for (std::map<std::string, rc_pair>::iterator it=locations.begin();it!=locations.end();it++) {
@@ -88,8 +87,7 @@ void regexmanager::handle_action(const std::string& action, const std::vector<st
 				rx = new regex_t;
  				// we need to create a new one for each push_back, otherwise we'd have double frees.
 				regcomp(rx, params[1].c_str(), REG_EXTENDED | REG_ICASE);
-				it->second.first.push_back(rx);
-				it->second.second.push_back(colorstr);
+				add_regex(it->first, rx, params[1], colorstr);
 			}
 		}
 		std::string line = "highlight";
@@ -140,8 +138,7 @@ void regexmanager::handle_action(const std::string& action, const std::vector<st
 
 		int pos = locations["articlelist"].first.size();
 
-		locations["articlelist"].first.push_back(NULL);
-		locations["articlelist"].second.push_back(colorstr);
+		add_regex("articlelist", NULL, "", colorstr);
 
 		matchers.push_back(std::pair<std::tr1::shared_ptr<matcher>, int>(m, pos));
 
@@ -149,6 +146,14 @@ void regexmanager::handle_action(const std::string& action, const std::vector<st
 		throw confighandlerexception(AHS_INVALID_COMMAND);
 }
 
+void regexmanager::add_regex(const std::string& location, regex_t * rx, const std::string& pattern, const std::string& colorstr) {
+	locations[location].first.push_back(rx);
+	locations[location].second.push_back(colorstr);
+	literal_index& index = literals[location];
+	index.required.push_back(rx ? literal_scanner::required_literal(pattern) : "");
+	index.dirty = true;
+}
+
 int regexmanager::article_matches(matchable * item) {
 	for (std::vector<std::pair<std::tr1::shared_ptr<matcher>, int> >::iterator it=matchers.begin();it!=matchers.end();it++) {
 		if (it->first->matches(item)) {
@@ -167,6 +172,10 @@ void regexmanager::remove_last_regex(const std::string& location) {
 	}
 	delete *it;
 	regexes.erase(it);
+
+	literal_index& index = literals[location];
+	index.required.pop_back();
+	index.dirty = true;
 }
 
 std::string regexmanager::extract_initial_marker(const std::string& str) {
@@ -185,26 +194,72 @@ std::string regexmanager::extract_initial_marker(const std::string& str) {
 
 void regexmanager::quote_and_highlight(std::string& str, const std::string& location) {
 	std::vector<regex_t *>& regexes = locations[location].first;
+	if (regexes.size() == 0)
+		return;
 
+	/*
+	 * A regular expression can't match if the line doesn't contain the
+	 * literal string that it requires, and one scan of the line tells which
+	 * of these literals it contains. So only the regular expressions that
+	 * may match have to be run, no matter how many there are.
+	 */
+	literal_index& index = literals[location];
+	if (index.dirty) {
+		index.scanner.build(index.required);
+		index.dirty = false;
+	}
+	std::vector<bool> found;
+	index.scanner.scan(str, found);
+
+	/*
+	 * all matches are searched for in the unmodified line, and every
+	 * character is given the style of the last regular expression that
+	 * matched it. The markers are inserted afterwards.
+	 */
+	std::vector<int> styles;
 	unsigned int i = 0;
 	for (std::vector<regex_t *>::iterator it=regexes.begin();it!=regexes.end();++it, ++i) {
-		if (!*it)
+		if (!*it || (index.required[i].length() > 0 && !found[i]))
 			continue;
-		std::string initial_marker = extract_initial_marker(str);
 		regmatch_t pmatch;
 		unsigned int offset = 0;
-		int err = regexec(*it, str.c_str(), 1, &pmatch, 0);
-		while (err == 0) {
-			// LOG(LOG_DEBUG, "regexmanager::quote_and_highlight: matched %s rm_so = %u rm_eo = %u", str.c_str() + offset, pmatch.rm_so, pmatch.rm_eo);
-			std::string marker = utils::strprintf("<%u>", i);
-			str.insert(offset + pmatch.rm_eo, std::string("</>") + initial_marker);
-			// LOG(LOG_DEBUG, "after first insert: %s", str.c_str());
-			str.insert(offset + pmatch.rm_so, marker);
-			// LOG(LOG_DEBUG, "after second insert: %s", str.c_str());
-			offset += pmatch.rm_eo + marker.length() + strlen("</>") + initial_marker.length();
-			err = regexec(*it, str.c_str() + offset, 1, &pmatch, 0);
+		while (offset < str.length() && regexec(*it, str.c_str() + offset, 1, &pmatch, 0) == 0) {
+			if (pmatch.rm_eo == pmatch.rm_so) {
+				// an empty match doesn't need to be highlighted
+				offset += pmatch.rm_so + 1;
+				continue;
+			}
+			if (styles.size() == 0)
+				styles.resize(str.length(), -1);
+			for (unsigned int pos=offset + pmatch.rm_so;pos<offset + pmatch.rm_eo;++pos) {
+				styles[pos] = i;
+			}
+			offset += pmatch.rm_eo;
+		}
+	}
+	if (styles.size() == 0)
+		return;
+
+	std::string initial_marker = extract_initial_marker(str);
+	std::string result;
+	int style = -1;
+	for (unsigned int pos=0;pos<str.length();++pos) {
+		if (styles[pos] != style) {
+			if (style != -1) {
+				result.append("</>");
+				result.append(initial_marker);
+			}
+			style = styles[pos];
+			if (style != -1)
+				result.append(utils::strprintf("<%d>", style));
 		}
+		result.append(1, str[pos]);
+	}
+	if (style != -1) {
+		result.append("</>");
+		result.append(initial_marker);
 	}
+	str.swap(result);
 }
 
 }
@@ -0,0 +1,376 @@
+#include <reloadpipeline.h>
+#include <controller.h>
+#include <view.h>
+#include <exceptions.h>
+#include <logger.h>
+#include <utils.h>
+#include <config.h>
+
+#include <unistd.h>
+
+namespace newsbeuter {
+
+/*
+ * The reload pipeline splits a reload into three stages that run
+ * concurrently and are connected by bounded queues:
+ *
+ *   - the fetch stage downloads the raw feed data; it has one pool of
+ *     reload-threads threads for network feeds and a separate pool of
+ *     plugin-processes threads that run exec: and filter: plugins, so that
+ *     slow scripts don't hold up the downloads (and vice versa),
+ *   - the parse stage (one thread per online CPU) turns it into rss_feed objects,
+ *   - the persist stage (the thread that called run()) writes the results to
+ *     the cache in batches and hands them over to the view.
+ *
+ * That way, network, CPU and disk work overlap, and the cache is only ever
+ * written to by a single thread.
+ *
+ * Feeds are handed to the fetch stage in order of their priority class: the
+ * focused feed first, then the feeds visible in the feed list, then feeds
+ * with unread articles, and then everything else. bump() moves a feed to
+ * the front while the reload is running. Feeds that are backing off after
+ * failed reloads are skipped (see failure_tracker), and the user is told
+ * how many were. Reloading a single feed explicitly (controller::reload())
+ * doesn't go through the pipeline and ignores the backoff.
+ *
+ * A reload can be cancelled through the reload_cancel token (bound to the
+ * cancel-reload key and to SIGUSR1): running downloads are aborted by
+ * libcurl's progress callback, running exec: and filter: plugins are
+ * killed, no new feeds are fetched, and everything that hasn't been
+ * persisted yet is thrown away.
+ */
+
+static unsigned int get_fetch_threads(controller * c, const char * option, unsigned int count) {
+	unsigned int n = c->get_cfg()->get_configvalue_as_int(option);
+	if (n < 1)
+		n = 1;
+	if (n > count)
+		n = count;
+	return n;
+}
+
+static unsigned int get_parse_threads(unsigned int count) {
+	long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+	if (n < 1)
+		n = 1;
+	if (count > 0 && static_cast<unsigned int>(n) > count)
+		n = count;
+	return n;
+}
+
+reload_queue::reload_queue(unsigned int capacity) : cap(capacity), closed(false) {
+	if (cap < 1)
+		cap = 1;
+}
+
+reload_queue::~reload_queue() {
+	for (std::deque<reload_job *>::iterator it=jobs.begin();it!=jobs.end();++it) {
+		delete *it;
+	}
+}
+
+void reload_queue::push(reload_job * job) {
+	scope_mutex lock(&mtx);
+	while (jobs.size() >= cap && !closed) {
+		not_full.wait(&mtx);
+	}
+	jobs.push_back(job);
+	not_empty.signal();
+}
+
+reload_job * reload_queue::pop() {
+	scope_mutex lock(&mtx);
+	while (jobs.size() == 0 && !closed) {
+		not_empty.wait(&mtx);
+	}
+	if (jobs.size() == 0)
+		return NULL;
+	reload_job * job = jobs.front();
+	jobs.pop_front();
+	not_full.signal();
+	return job;
+}
+
+bool reload_queue::pop_all(std::vector<reload_job *>& batch) {
+	scope_mutex lock(&mtx);
+	while (jobs.size() == 0 && !closed) {
+		not_empty.wait(&mtx);
+	}
+	if (jobs.size() == 0)
+		return false;
+	batch.insert(batch.end(), jobs.begin(), jobs.end());
+	jobs.clear();
+	not_full.broadcast();
+	return true;
+}
+
+void reload_queue::close() {
+	scope_mutex lock(&mtx);
+	closed = true;
+	not_empty.broadcast();
+	not_full.broadcast();
+}
+
+reload_pipeline::reload_pipeline(controller * c, const std::vector<int>& indexes, bool unattended)
+	: ctrl(c), count(indexes.size()), scheduled(c->feeds.size(), true), u(unattended),
+	  parse_threads(get_parse_threads(indexes.size())),
+	  fetchers_running(0), parsers_running(0), skipped(0),
+	  parse_queue(2 * parse_threads), persist_queue(2 * parse_threads) {
+	std::string focused;
+	{
+		scope_mutex lock(&ctrl->reload_prio_mtx);
+		focused = ctrl->focused_feed;
+	}
+
+	std::vector<bool> visible(ctrl->feeds.size(), false);
+	if (!u) {
+		std::vector<unsigned int> positions = ctrl->v->get_visible_feed_positions();
+		for (std::vector<unsigned int>::iterator it=positions.begin();it!=positions.end();++it) {
+			if (*it < visible.size())
+				visible[*it] = true;
+		}
+	}
+
+	for (std::vector<int>::const_iterator it=indexes.begin();it!=indexes.end();++it) {
+		unsigned int pos = *it;
+		if (pos >= ctrl->feeds.size()) {
+			LOG(LOG_ERROR, "reload_pipeline::reload_pipeline: invalid feed index %u", pos);
+			continue;
+		}
+		scheduled[pos] = false;
+		std::tr1::shared_ptr<rss_feed> feed = ctrl->feeds[pos];
+		fetch_pool pool = get_pool(pos);
+		if (focused != "" && feed->rssurl() == focused) {
+			pending[pool][RELOAD_PRIO_FOCUSED].push_back(pos);
+		} else if (visible[pos]) {
+			pending[pool][RELOAD_PRIO_VISIBLE].push_back(pos);
+		} else if (feed->unread_item_count() > 0) {
+			pending[pool][RELOAD_PRIO_UNREAD].push_back(pos);
+		} else {
+			pending[pool][RELOAD_PRIO_OTHER].push_back(pos);
+		}
+	}
+
+	for (unsigned int pool=0;pool<FETCH_POOL_MAX;pool++) {
+		unsigned int feeds = 0;
+		for (unsigned int prio=0;prio<RELOAD_PRIO_MAX;prio++) {
+			feeds += pending[pool][prio].size();
+		}
+		fetch_threads[pool] = get_fetch_threads(ctrl, pool == FETCH_POOL_PLUGIN ? "plugin-processes" : "reload-threads", feeds);
+	}
+}
+
+reload_pipeline::~reload_pipeline() { }
+
+void reload_pipeline::run() {
+	scope_measure m1("reload_pipeline::run");
+	LOG(LOG_DEBUG, "reload_pipeline::run: %u feeds, %u fetch threads, %u plugin threads, %u parse threads", count, fetch_threads[FETCH_POOL_NETWORK], fetch_threads[FETCH_POOL_PLUGIN], parse_threads);
+
+	{
+		scope_mutex lock(&ctrl->reload_prio_mtx);
+		ctrl->active_pipeline = this;
+	}
+
+	reload_cancel.reset();
+
+	fetchers_running = fetch_threads[FETCH_POOL_NETWORK] + fetch_threads[FETCH_POOL_PLUGIN];
+	parsers_running = parse_threads;
+
+	if (fetchers_running == 0)
+		parse_queue.close();
+
+	std::vector<pthread_t> threads;
+	for (unsigned int pool=0;pool<FETCH_POOL_MAX;pool++) {
+		for (unsigned int i=0;i<fetch_threads[pool];i++) {
+			reload_fetchthread * t = new reload_fetchthread(this, static_cast<fetch_pool>(pool));
+			threads.push_back(t->start());
+		}
+	}
+	for (unsigned int i=0;i<parse_threads;i++) {
+		reload_parsethread * t = new reload_parsethread(this);
+		threads.push_back(t->start());
+	}
+
+	std::vector<reload_job *> batch;
+	while (persist_queue.pop_all(batch)) {
+		persist_batch(batch);
+		batch.clear();
+	}
+
+	LOG(LOG_DEBUG, "reload_pipeline::run: joining fetch and parse threads...");
+	for (std::vector<pthread_t>::iterator it=threads.begin();it!=threads.end();++it) {
+		::pthread_join(*it, NULL);
+	}
+
+	if (reload_cancel.is_cancelled()) {
+		LOG(LOG_INFO, "reload_pipeline::run: reload was cancelled");
+		if (!u)
+			ctrl->v->set_status(_("Reload cancelled."));
+	} else if (skipped > 0) {
+		LOG(LOG_INFO, "reload_pipeline::run: skipped %u feeds that are backing off", skipped);
+		if (!u)
+			ctrl->v->set_status(utils::strprintf(_("Skipped %u feeds that failed recently."), skipped));
+	}
+
+	{
+		scope_mutex lock(&ctrl->reload_prio_mtx);
+		ctrl->active_pipeline = NULL;
+	}
+}
+
+void reload_pipeline::bump(unsigned int pos) {
+	scope_mutex lock(&mtx);
+	if (pos < scheduled.size() && !scheduled[pos]) {
+		LOG(LOG_DEBUG, "reload_pipeline::bump: moving feed #%u to the front", pos);
+		pending[get_pool(pos)][RELOAD_PRIO_FOCUSED].push_front(pos);
+	}
+}
+
+fetch_pool reload_pipeline::get_pool(unsigned int pos) {
+	const std::string& rssurl = ctrl->feeds[pos]->rssurl();
+	if (rssurl.substr(0,5) == "exec:" || rssurl.substr(0,7) == "filter:")
+		return FETCH_POOL_PLUGIN;
+	return FETCH_POOL_NETWORK;
+}
+
+bool reload_pipeline::next_index(fetch_pool pool, unsigned int& pos) {
+	scope_mutex lock(&mtx);
+	for (unsigned int prio=0;prio<RELOAD_PRIO_MAX;prio++) {
+		while (pending[pool][prio].size() > 0) {
+			pos = pending[pool][prio].front();
+			pending[pool][prio].pop_front();
+			// a bumped feed may be queued twice; only the first one counts.
+			if (!scheduled[pos]) {
+				scheduled[pos] = true;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void reload_pipeline::stage_finished(unsigned int& running, reload_queue& next_stage) {
+	scope_mutex lock(&mtx);
+	if (--running == 0) {
+		next_stage.close();
+	}
+}
+
+std::string reload_pipeline::error_message(reload_job * job, const char * what) {
+	return utils::strprintf(_("Error while retrieving %s: %s"), utils::censor_url(job->rssurl).c_str(), what);
+}
+
+void reload_pipeline::count_skipped() {
+	scope_mutex lock(&mtx);
+	++skipped;
+}
+
+void reload_pipeline::fetch_loop(fetch_pool pool) {
+	bool ignore_dl = (ctrl->cfg.get_configvalue("ignore-mode") == "download");
+	unsigned int pos;
+
+	while (!reload_cancel.is_cancelled() && next_index(pool, pos)) {
+		std::string rssurl = ctrl->feeds[pos]->rssurl();
+		if (!ctrl->reload_failures->may_reload(rssurl)) {
+			count_skipped();
+			continue;
+		}
+		if (!u)
+			ctrl->v->set_status(utils::strprintf(_("%sLoading %s..."), ctrl->prepare_message(pos+1, ctrl->feeds.size()).c_str(), utils::censor_url(rssurl).c_str()));
+
+		reload_job * job = new reload_job(pos, rssurl, new rss_parser(rssurl.c_str(), ctrl->rsscache, &ctrl->cfg, ignore_dl ? &ctrl->ign : NULL, ctrl->api), ctrl->reload_failures);
+		job->parser->set_cancel_token(&reload_cancel);
+		LOG(LOG_DEBUG, "reload_pipeline::fetch_loop: fetching feed #%u (pool %u)", pos, pool);
+		try {
+			job->parser->fetch();
+		} catch (const dbexception& e) {
+			job->errmsg = error_message(job, e.what());
+		} catch (const std::string& emsg) {
+			job->errmsg = error_message(job, emsg.c_str());
+		} catch (rsspp::exception& e) {
+			job->errmsg = error_message(job, e.what());
+			job->host_down = failure_tracker::is_host_error(e.curl_error());
+		}
+		parse_queue.push(job);
+	}
+
+	stage_finished(fetchers_running, parse_queue);
+}
+
+void reload_pipeline::parse_loop() {
+	reload_job * job;
+
+	while ((job = parse_queue.pop()) != NULL) {
+		if (reload_cancel.is_cancelled()) {
+			delete job;
+			continue;
+		}
+		if (job->errmsg == "") {
+			LOG(LOG_DEBUG, "reload_pipeline::parse_loop: parsing feed #%u", job->pos);
+			try {
+				job->feed = job->parser->build_feed();
+			} catch (const std::string& emsg) {
+				job->errmsg = error_message(job, emsg.c_str());
+			} catch (rsspp::exception& e) {
+				job->errmsg = error_message(job, e.what());
+			}
+		}
+		persist_queue.push(job);
+	}
+
+	stage_finished(parsers_running, persist_queue);
+}
+
+void reload_pipeline::persist_batch(std::vector<reload_job *>& batch) {
+	LOG(LOG_DEBUG, "reload_pipeline::persist_batch: persisting %u feeds", batch.size());
+	bool feedlist_changed = false;
+	std::string errmsg;
+
+	ctrl->rsscache->begin_transaction();
+	for (std::vector<reload_job *>::iterator it=batch.begin();it!=batch.end();++it) {
+		reload_job * job = *it;
+		if (reload_cancel.is_cancelled()) {
+			LOG(LOG_DEBUG, "reload_pipeline::persist_batch: reload cancelled, dropping %s", job->rssurl.c_str());
+			delete job;
+			continue;
+		}
+		if (job->errmsg == "") {
+			try {
+				job->parser->commit(job->feed);
+				ctrl->reload_failures->record_success(job->rssurl);
+				job->recorded = true;
+				if (job->feed->items().size() > 0) {
+					ctrl->save_feed(job->feed, job->pos);
+					ctrl->enqueue_items(job->feed);
+					feedlist_changed = true;
+				} else {
+					LOG(LOG_DEBUG, "reload_pipeline::persist_batch: feed is empty");
+				}
+			} catch (const dbexception& e) {
+				job->errmsg = error_message(job, e.what());
+			}
+		}
+		if (job->errmsg != "") {
+			ctrl->reload_failures->record_failure(job->rssurl, job->host_down);
+			job->recorded = true;
+			LOG(LOG_USERERROR, "%s", job->errmsg.c_str());
+			errmsg = job->errmsg;
+		}
+		delete job;
+	}
+	ctrl->rsscache->end_transaction();
+
+	if (feedlist_changed && !u)
+		ctrl->v->set_feedlist(ctrl->feeds);
+	ctrl->v->set_status(errmsg);
+}
+
+void reload_fetchthread::run() {
+	pipeline->fetch_loop(pool);
+}
+
+void reload_parsethread::run() {
+	pipeline->parse_loop();
+}
+
+}
@@ -9,6 +9,7 @@
 #include <iostream>
 #include <configcontainer.h>
 #include <cstring>
+#include <cctype>
 #include <algorithm>
 #include <curl/curl.h>
 #include <sys/utsname.h>
@@ -22,7 +23,8 @@
 
 namespace newsbeuter {
 
-rss_item::rss_item(cache * c) : unread_(true), ch(c), enqueued_(false), deleted_(0), idx(0), override_unread_(false) {
+rss_item::rss_item(cache * c) : unread_(true), ch(c), enqueued_(false), deleted_(0), idx(0), override_unread_(false), generation_(0) {
+	touch();
 	// LOG(LOG_CRITICAL, "new rss_item");
 }
 
@@ -30,15 +32,17 @@ rss_item::~rss_item() {
 	// LOG(LOG_CRITICAL, "delete rss_item");
 }
 
-rss_feed::rss_feed(cache * c) : ch(c), empty(true), is_rtl_(false), idx(0) {
+rss_feed::rss_feed(cache * c) : unread_count_(0), ch(c), empty(true), is_rtl_(false), idx(0), generation_(0) {
 	// LOG(LOG_CRITICAL, "new rss_feed");
 }
 
-rss_feed::rss_feed() : ch(NULL), empty(true), is_rtl_(false) { 
+rss_feed::rss_feed() : unread_count_(0), ch(NULL), empty(true), is_rtl_(false), idx(0), generation_(0) { 
 	// LOG(LOG_CRITICAL, "new rss_feed");
 }
 
 rss_feed::~rss_feed() {
+	// items may outlive the feed, so they must not refer to it anymore
+	uncount_items(items_.begin(), items_.end());
 	// LOG(LOG_CRITICAL, "delete rss_feed");
 }
 
@@ -47,20 +51,74 @@ rss_feed::~rss_feed() {
 void rss_item::set_title(const std::string& t) { 
 	title_ = t; 
 	utils::trim(title_);
+	update_title_display();
+	touch();
 }
 
 
 void rss_item::set_link(const std::string& l) { 
 	link_ = l; 
 	utils::trim(link_);
+	touch();
 }
 
 void rss_item::set_author(const std::string& a) { 
 	author_ = a; 
+	update_author_display();
+	touch();
 }
 
 void rss_item::set_description(const std::string& d) { 
 	description_ = d; 
+	touch();
+}
+
+/*
+ * The take_* setters are the counterparts of the set_* setters for strings
+ * that the caller doesn't need anymore: instead of copying the string, they
+ * swap its buffer into the item, leaving the argument with the item's old
+ * value (usually empty). rss_parser uses them to hand over the text that
+ * rsspp parsed without copying it again.
+ */
+
+void rss_item::take_title(std::string& t) {
+	title_.swap(t);
+	utils::trim(title_);
+	update_title_display();
+	touch();
+}
+
+void rss_item::take_author(std::string& a) {
+	author_.swap(a);
+	update_author_display();
+	touch();
+}
+
+/*
+ * Title and author are displayed, sorted and matched far more often than
+ * they are set, so they are converted to the locale's charset only when they
+ * change. title_sortkey_ is the converted title in lower case, so comparing
+ * sort keys gives the same order as strcasecmp on the titles.
+ */
+
+void rss_item::update_title_display() {
+	if (title_.length() > 0)
+		title_display_ = utils::convert_text(title_, nl_langinfo(CODESET), "utf-8");
+	else
+		title_display_.clear();
+	title_sortkey_ = title_display_;
+	for (std::string::iterator it=title_sortkey_.begin();it!=title_sortkey_.end();++it) {
+		*it = ::tolower(static_cast<unsigned char>(*it));
+	}
+}
+
+void rss_item::update_author_display() {
+	author_display_ = utils::convert_text(author_, nl_langinfo(CODESET), "utf-8");
+}
+
+void rss_item::take_description(std::string& d) {
+	description_.swap(d);
+	touch();
 }
 
 std::string rss_item::length() const {
@@ -77,34 +135,154 @@ std::string rss_item::length() const {
 
 void rss_item::set_pubDate(time_t t) { 
 	pubDate_ = t; 
+	touch();
 }
 
 void rss_item::set_guid(const std::string& g) { 
 	guid_ = g; 
+	touch();
 }
 
-void rss_item::set_unread_nowrite(bool u) {
+void rss_item::take_guid(std::string& g) {
+	guid_.swap(g);
+	touch();
+}
+
+/*
+ * Every feed keeps count of its unread items, so that the feed list, the
+ * unread_count attribute and the unread totals don't have to look at every
+ * single item. An item can be part of several feeds at the same time (its
+ * own feed and any number of query feeds), so it remembers all feeds that
+ * count it and updates all of them whenever its unread flag changes.
+ * Adding items to feeds and removing them happens in the reload threads as
+ * well, so this bookkeeping is protected by a mutex of its own.
+ *
+ * Feeds and items also have generations, which query feeds use to find out
+ * which feeds changed since they were last updated, and the matcher to find
+ * out whether it already knows the result for an item. Every change draws
+ * a new number from a global counter, so that a feed or item that replaces
+ * another one (e.g. after a reload) never has the same generation. Only
+ * feeds that never had any items or attributes are still at generation 0.
+ * Every setter of every parsed item bumps its generation, so the counter
+ * and the generations are updated with atomic operations instead of taking
+ * the mutex, which would serialize the parser threads.
+ */
+
+static mutex unread_count_mtx;
+static unsigned long last_generation = 0;
+
+static inline void new_generation(unsigned long& generation) {
+	// __sync_add_and_fetch() is a full barrier, so whoever sees the new
+	// generation also sees the change that caused it
+	__sync_lock_test_and_set(&generation, __sync_add_and_fetch(&last_generation, 1));
+}
+
+static inline unsigned long read_generation(unsigned long& generation) {
+	return __sync_add_and_fetch(&generation, 0);
+}
+
+void rss_feed::touch() {
+	new_generation(generation_);
+}
+
+unsigned long rss_feed::generation() {
+	return read_generation(generation_);
+}
+
+unsigned long rss_feed::attribute_generation() {
+	return generation();
+}
+
+void rss_item::touch() {
+	new_generation(generation_);
+}
+
+/*
+ * an item's attributes include the ones of its feed, so the item's
+ * attributes changed if either of them did. As generations only grow, the
+ * larger of the two is new after every change of either.
+ */
+unsigned long rss_item::attribute_generation() {
+	unsigned long generation = read_generation(generation_);
+	if (feedptr) {
+		unsigned long feed_generation = feedptr->generation();
+		if (feed_generation > generation)
+			return feed_generation;
+	}
+	return generation;
+}
+
+void rss_item::touch_feeds() {
+	touch();
+	scope_mutex lock(&unread_count_mtx);
+	for (std::vector<rss_feed *>::iterator it=counting_feeds.begin();it!=counting_feeds.end();++it) {
+		(*it)->touch();
+	}
+}
+
+void rss_item::set_unread_state(bool u) {
+	scope_mutex lock(&unread_count_mtx);
+	if (unread_ == u)
+		return;
 	unread_ = u;
+	touch();
+	for (std::vector<rss_feed *>::iterator it=counting_feeds.begin();it!=counting_feeds.end();++it) {
+		if (u)
+			++(*it)->unread_count_;
+		else
+			--(*it)->unread_count_;
+		(*it)->touch();
+	}
+}
+
+void rss_feed::count_item(std::tr1::shared_ptr<rss_item> item) {
+	scope_mutex lock(&unread_count_mtx);
+	item->counting_feeds.push_back(this);
+	if (item->unread_)
+		++unread_count_;
+	touch();
+}
+
+void rss_feed::uncount_items(std::vector<std::tr1::shared_ptr<rss_item> >::iterator begin, std::vector<std::tr1::shared_ptr<rss_item> >::iterator end) {
+	scope_mutex lock(&unread_count_mtx);
+	for (std::vector<std::tr1::shared_ptr<rss_item> >::iterator it=begin;it!=end;++it) {
+		std::vector<rss_feed *>& feeds = (*it)->counting_feeds;
+		std::vector<rss_feed *>::iterator self = std::find(feeds.begin(), feeds.end(), this);
+		if (self != feeds.end())
+			feeds.erase(self);
+		if ((*it)->unread_)
+			--unread_count_;
+	}
+	touch();
+}
+
+void rss_item::set_unread_nowrite(bool u) {
+	set_unread_state(u);
 }
 
 void rss_item::set_unread_nowrite_notify(bool u, bool notify) {
-	unread_ = u;
+	set_unread_state(u);
 	if (feedptr && notify) {
-		feedptr->get_item_by_guid(guid_)->set_unread_nowrite(unread_); // notify parent feed
+		std::tr1::shared_ptr<rss_item> item = feedptr->get_item_by_guid(guid_);
+		if (item)
+			item->set_unread_nowrite(unread_); // notify parent feed
 	}
 }
 
 void rss_item::set_unread(bool u) { 
 	if (unread_ != u) {
 		bool old_u = unread_;
-		unread_ = u;
-		if (feedptr)
-			feedptr->get_item_by_guid(guid_)->set_unread_nowrite(unread_); // notify parent feed
+		set_unread_state(u);
+		if (feedptr) {
+			std::tr1::shared_ptr<rss_item> item = feedptr->get_item_by_guid(guid_);
+			if (item)
+				item->set_unread_nowrite(unread_); // notify parent feed
+		}
 		try {
 			if (ch) ch->update_rssitem_unread_and_enqueued(this, feedurl_); 
 		} catch (const dbexception& e) {
 			// if the update failed, restore the old unread flag and rethrow the exception
-			unread_ = old_u; 
+			set_unread_state(old_u);
 			throw e;
 		}
 	}
@@ -112,19 +290,12 @@ void rss_item::set_unread(bool u) {
 
 std::string rss_item::pubDate() const {
 	char text[1024];
-	strftime(text,sizeof(text),"%a, %d %b %Y %T %z", localtime(&pubDate_)); 
+	struct tm stm;
+	// localtime_r(), since the date may be matched by several threads
+	strftime(text,sizeof(text),"%a, %d %b %Y %T %z", localtime_r(&pubDate_, &stm)); 
 	return std::string(text);
 }
 
-unsigned int rss_feed::unread_item_count() {
-	scope_mutex lock(&item_mutex);
-	unsigned int count = 0;
-	for (std::vector<std::tr1::shared_ptr<rss_item> >::const_iterator it=items_.begin();it!=items_.end();++it) {
-		if ((*it)->unread())
-			++count;
-	}
-	return count;
-}
 
 
 bool rss_feed::matches_tag(const std::string& tag) {
@@ -154,28 +325,25 @@ std::string rss_feed::get_tags() {
 
 void rss_feed::set_tags(const std::vector<std::string>& tags) {
 	tags_.clear();
+	tag_words.clear();
 	for (std::vector<std::string>::const_iterator it=tags.begin();it!=tags.end();++it) {
 		tags_.push_back(*it);
+		if (it->substr(0,1) != "~") {
+			std::vector<std::string> words = utils::tokenize(*it, " ");
+			tag_words.insert(words.begin(), words.end());
+		}
 	}
+	touch();
 }
 
 void rss_item::set_enclosure_url(const std::string& url) {
 	enclosure_url_ = url;
+	touch();
 }
 
 void rss_item::set_enclosure_type(const std::string& type) {
 	enclosure_type_ = type;
-}
-
-std::string rss_item::title() const {
-	std::string retval;
-	if (title_.length()>0)
-		retval = utils::convert_text(title_, nl_langinfo(CODESET), "utf-8");
-	return retval;
-}
-
-std::string rss_item::author() const {
-	return utils::convert_text(author_, nl_langinfo(CODESET), "utf-8");
+	touch();
 }
 
 std::string rss_item::description() const {
@@ -199,74 +367,222 @@ std::string rss_feed::description() const {
 	return utils::convert_text(description_, nl_langinfo(CODESET), "utf-8");
 }
 
-std::tr1::shared_ptr<rss_item> rss_feed::get_item_by_guid(const std::string& guid) {
-	scope_mutex lock(&item_mutex);
+/*
+ * items_guid_map indexes items_ by guid, so that looking up an item (which
+ * happens for every item that is opened or marked, and for every unread
+ * notification from a query feed) doesn't have to scan all items. If several
+ * items share a guid, the index points to the first one that was added.
+ */
+
+void rss_feed::add_item(std::tr1::shared_ptr<rss_item> item) {
+	sorted_by.clear();
+	items_.push_back(item);
+	items_guid_map.insert(std::make_pair(item->guid(), item));
+	count_item(item);
+}
+
+void rss_feed::set_items(const std::vector<std::tr1::shared_ptr<rss_item> >& items) {
+	uncount_items(items_.begin(), items_.end());
+	items_ = items;
+	sorted_by.clear();
+	rebuild_guid_map();
 	for (std::vector<std::tr1::shared_ptr<rss_item> >::iterator it=items_.begin();it!=items_.end();++it) {
-		if ((*it)->guid() == guid) {
-			return *it;
+		count_item(*it);
+	}
+}
+
+void rss_feed::clear_items() {
+	uncount_items(items_.begin(), items_.end());
+	items_.clear();
+	items_guid_map.clear();
+}
+
+std::vector<std::tr1::shared_ptr<rss_item> >::iterator rss_feed::erase_item(std::vector<std::tr1::shared_ptr<rss_item> >::iterator it) {
+	std::tr1::shared_ptr<rss_item> item = *it;
+	uncount_items(it, it + 1);
+	std::vector<std::tr1::shared_ptr<rss_item> >::iterator next = items_.erase(it);
+
+	std::tr1::unordered_map<std::string, std::tr1::shared_ptr<rss_item> >::iterator entry = items_guid_map.find(item->guid());
+	if (entry != items_guid_map.end() && entry->second == item) {
+		items_guid_map.erase(entry);
+		// another item with the same guid takes its place
+		for (std::vector<std::tr1::shared_ptr<rss_item> >::iterator jt=items_.begin();jt!=items_.end();++jt) {
+			if ((*jt)->guid() == item->guid()) {
+				items_guid_map.insert(std::make_pair((*jt)->guid(), *jt));
+				break;
+			}
 		}
 	}
-	LOG(LOG_DEBUG, "rss_feed::get_item_by_guid: hit dummy item!");
-	// abort();
-	return std::tr1::shared_ptr<rss_item>(new rss_item(ch)); // should never happen!
+	return next;
+}
+
+void rss_feed::erase_items(std::vector<std::tr1::shared_ptr<rss_item> >::iterator begin, std::vector<std::tr1::shared_ptr<rss_item> >::iterator end) {
+	uncount_items(begin, end);
+	items_.erase(begin, end);
+	rebuild_guid_map();
+}
+
+void rss_feed::finish_removal(std::vector<std::tr1::shared_ptr<rss_item> >& removed, std::vector<std::tr1::shared_ptr<rss_item> >::iterator end) {
+	// after the compaction, everything from end on is one of the removed
+	// items, so these are dropped and only the removed items are uncounted.
+	bool duplicate_guids = (items_guid_map.size() != items_.size());
+	items_.erase(end, items_.end());
+	if (removed.size() > 0) {
+		uncount_items(removed.begin(), removed.end());
+		if (duplicate_guids) {
+			// another item may have to take the place of a removed one
+			rebuild_guid_map();
+		} else {
+			for (std::vector<std::tr1::shared_ptr<rss_item> >::iterator it=removed.begin();it!=removed.end();++it) {
+				items_guid_map.erase((*it)->guid());
+			}
+		}
+	}
+}
+
+void rss_feed::rebuild_guid_map() {
+	items_guid_map.clear();
+	for (std::vector<std::tr1::shared_ptr<rss_item> >::iterator it=items_.begin();it!=items_.end();++it) {
+		items_guid_map.insert(std::make_pair((*it)->guid(), *it));
+	}
+}
+
+std::tr1::shared_ptr<rss_item> rss_feed::get_item_by_guid(const std::string& guid) {
+	scope_mutex lock(&item_mutex);
+	std::tr1::unordered_map<std::string, std::tr1::shared_ptr<rss_item> >::iterator it = items_guid_map.find(guid);
+	if (it != items_guid_map.end())
+		return it->second;
+	LOG(LOG_DEBUG, "rss_feed::get_item_by_guid: no item with guid `%s'", guid.c_str());
+	return std::tr1::shared_ptr<rss_item>();
 }
 
 bool rss_item::has_attribute(const std::string& attribname) {
-	// LOG(LOG_DEBUG, "rss_item::has_attribute(%s) called", attribname.c_str());
-	if (attribname == "title" || 
-		attribname == "link" || 
-		attribname == "author" || 
-		attribname == "content" || 
-		attribname == "date"  ||
-		attribname == "guid" ||
-		attribname == "unread" ||
-		attribname == "enclosure_url" ||
-		attribname == "enclosure_type" ||
-		attribname == "flags" ||
-		attribname == "age" ||
-		attribname == "articleindex")
+	return has_attribute(get_attribute_id(attribname), attribname);
+}
+
+bool rss_item::has_attribute(attribute_id id, const std::string& attribname) {
+	switch (id) {
+		case ATTR_TITLE:
+		case ATTR_LINK:
+		case ATTR_AUTHOR:
+		case ATTR_CONTENT:
+		case ATTR_DATE:
+		case ATTR_GUID:
+		case ATTR_UNREAD:
+		case ATTR_ENCLOSURE_URL:
+		case ATTR_ENCLOSURE_TYPE:
+		case ATTR_FLAGS:
+		case ATTR_AGE:
+		case ATTR_ARTICLEINDEX:
 			return true;
+		default:
+			break;
+	}
 
 	// if we have a feed, then forward the request
 	if (feedptr)
-		return feedptr->rss_feed::has_attribute(attribname);
+		return feedptr->rss_feed::has_attribute(id, attribname);
 
 	return false;
 }
 
 std::string rss_item::get_attribute(const std::string& attribname) {
-	if (attribname == "title")
-		return title();
-	else if (attribname == "link")
-		return link();
-	else if (attribname == "author")
-		return author();
-	else if (attribname == "content")
-		return description();
-	else if (attribname == "date")
-		return pubDate();
-	else if (attribname == "guid")
-		return guid();
-	else if (attribname == "unread")
-		return unread_ ? "yes" : "no";
-	else if (attribname == "enclosure_url")
-		return enclosure_url();
-	else if (attribname == "enclosure_type")
-		return enclosure_type();
-	else if (attribname == "flags")
-		return flags();
-	else if (attribname == "age")
-		return utils::to_s((time(NULL) - pubDate_timestamp()) / 86400);
-	else if (attribname == "articleindex")
-		return utils::to_s(idx);
+	return get_attribute(get_attribute_id(attribname), attribname);
+}
+
+std::string rss_item::get_attribute(attribute_id id, const std::string& attribname) {
+	switch (id) {
+		case ATTR_TITLE:
+			return title();
+		case ATTR_LINK:
+			return link();
+		case ATTR_AUTHOR:
+			return author();
+		case ATTR_CONTENT:
+			return description();
+		case ATTR_DATE:
+			return pubDate();
+		case ATTR_GUID:
+			return guid();
+		case ATTR_UNREAD:
+			return unread_ ? "yes" : "no";
+		case ATTR_ENCLOSURE_URL:
+			return enclosure_url();
+		case ATTR_ENCLOSURE_TYPE:
+			return enclosure_type();
+		case ATTR_FLAGS:
+			return flags();
+		case ATTR_AGE:
+		case ATTR_ARTICLEINDEX:
+			return utils::to_s(get_attribute_int(id, attribname));
+		default:
+			break;
+	}
 
 	// if we have a feed, then forward the request
 	if (feedptr)
-		return feedptr->rss_feed::get_attribute(attribname);
+		return feedptr->rss_feed::get_attribute(id, attribname);
 
 	return "";
 }
 
+long rss_item::get_attribute_int(attribute_id id, const std::string& attribname) {
+	switch (id) {
+		case ATTR_AGE:
+			return (time(NULL) - pubDate_timestamp()) / 86400;
+		case ATTR_ARTICLEINDEX:
+			return idx;
+		default:
+			break;
+	}
+	if (feedptr && feedptr->rss_feed::has_attribute(id, attribname))
+		return feedptr->rss_feed::get_attribute_int(id, attribname);
+	return matchable::get_attribute_int(id, attribname);
+}
+
+time_t rss_item::get_attribute_time(attribute_id id, const std::string& attribname) {
+	if (id == ATTR_DATE)
+		return pubDate_timestamp();
+	if (feedptr)
+		return feedptr->rss_feed::get_attribute_time(id, attribname);
+	return 0;
+}
+
+static const std::string unread_yes = "yes";
+static const std::string unread_no = "no";
+
+const std::string& rss_item::get_attribute_ref(attribute_id id, const std::string& attribname, std::string& buf) {
+	switch (id) {
+		case ATTR_TITLE:
+			return title();
+		case ATTR_LINK:
+			return link();
+		case ATTR_AUTHOR:
+			return author();
+		case ATTR_GUID:
+			return guid();
+		case ATTR_UNREAD:
+			return unread_ ? unread_yes : unread_no;
+		case ATTR_ENCLOSURE_URL:
+			return enclosure_url();
+		case ATTR_ENCLOSURE_TYPE:
+			return enclosure_type();
+		case ATTR_FLAGS:
+			return flags();
+		default:
+			break;
+	}
+	if (feedptr && feedptr->rss_feed::has_attribute(id, attribname))
+		return feedptr->rss_feed::get_attribute_ref(id, attribname, buf);
+	return matchable::get_attribute_ref(id, attribname, buf);
+}
+
+const std::tr1::unordered_set<std::string> * rss_item::get_attribute_words(attribute_id id, const std::string& attribname) {
+	if (feedptr && feedptr->rss_feed::has_attribute(id, attribname))
+		return feedptr->rss_feed::get_attribute_words(id, attribname);
+	return NULL;
+}
+
 void rss_item::update_flags() {
 	if (ch) {
 		ch->update_rssitem_flags(this);
@@ -277,6 +593,12 @@ void rss_item::set_flags(const std::string& ff) {
 	oldflags_ = flags_;
 	flags_ = ff;
 	sort_flags();
+	touch_feeds();
+}
+
+void rss_item::set_deleted(bool b) {
+	deleted_ = b;
+	touch_feeds();
 }
 
 void rss_item::sort_flags() {
@@ -300,40 +622,82 @@ void rss_item::sort_flags() {
 }
 
 bool rss_feed::has_attribute(const std::string& attribname) {
-	if (attribname == "feedtitle" ||
-		attribname == "description" ||
-		attribname == "feedlink" ||
-		attribname == "feeddate" ||
-		attribname == "rssurl" ||
-		attribname == "unread_count" ||
-		attribname == "total_count" ||
-		attribname == "tags" ||
-		attribname == "feedindex")
+	return has_attribute(get_attribute_id(attribname), attribname);
+}
+
+bool rss_feed::has_attribute(attribute_id id, const std::string& /* attribname */) {
+	switch (id) {
+		case ATTR_FEEDTITLE:
+		case ATTR_DESCRIPTION:
+		case ATTR_FEEDLINK:
+		case ATTR_FEEDDATE:
+		case ATTR_RSSURL:
+		case ATTR_UNREAD_COUNT:
+		case ATTR_TOTAL_COUNT:
+		case ATTR_TAGS:
+		case ATTR_FEEDINDEX:
 			return true;
-	return false;
+		default:
+			return false;
+	}
 }
 
 std::string rss_feed::get_attribute(const std::string& attribname) {
-	if (attribname == "feedtitle")
-		return title();
-	else if (attribname == "description")
-		return description();
-	else if (attribname == "feedlink")
-		return title();
-	else if (attribname == "feeddate")
-		return pubDate();
-	else if (attribname == "rssurl")
-		return rssurl();
-	else if (attribname == "unread_count") {
-		return utils::to_s(unread_item_count());
-	} else if (attribname == "total_count") {
-		return utils::to_s(items_.size());
-	} else if (attribname == "tags") {
-		return get_tags();
-	} else if (attribname == "feedindex") {
-		return utils::to_s(idx);
+	return get_attribute(get_attribute_id(attribname), attribname);
+}
+
+std::string rss_feed::get_attribute(attribute_id id, const std::string& attribname) {
+	switch (id) {
+		case ATTR_FEEDTITLE:
+			return title();
+		case ATTR_DESCRIPTION:
+			return description();
+		case ATTR_FEEDLINK:
+			return title();
+		case ATTR_FEEDDATE:
+			return pubDate();
+		case ATTR_RSSURL:
+			return rssurl();
+		case ATTR_UNREAD_COUNT:
+		case ATTR_TOTAL_COUNT:
+		case ATTR_FEEDINDEX:
+			return utils::to_s(get_attribute_int(id, attribname));
+		case ATTR_TAGS:
+			return get_tags();
+		default:
+			return "";
 	}
-	return "";
+}
+
+long rss_feed::get_attribute_int(attribute_id id, const std::string& attribname) {
+	switch (id) {
+		case ATTR_UNREAD_COUNT:
+			return unread_item_count();
+		case ATTR_TOTAL_COUNT:
+			return items_.size();
+		case ATTR_FEEDINDEX:
+			return idx;
+		default:
+			return matchable::get_attribute_int(id, attribname);
+	}
+}
+
+time_t rss_feed::get_attribute_time(attribute_id id, const std::string& /* attribname */) {
+	if (id == ATTR_FEEDDATE)
+		return pubDate_;
+	return 0;
+}
+
+const std::string& rss_feed::get_attribute_ref(attribute_id id, const std::string& attribname, std::string& buf) {
+	if (id == ATTR_RSSURL)
+		return rssurl();
+	return matchable::get_attribute_ref(id, attribname, buf);
+}
+
+const std::tr1::unordered_set<std::string> * rss_feed::get_attribute_words(attribute_id id, const std::string& /* attribname */) {
+	if (id == ATTR_TAGS)
+		return &tag_words;
+	return NULL;
 }
 
 void rss_ignores::handle_action(const std::string& action, const std::vector<std::string>& params) {
@@ -345,6 +709,10 @@ void rss_ignores::handle_action(const std::string& action, const std::vector<std
 		matcher m;
 		if (!m.parse(ignore_expr))
 			throw confighandlerexception(utils::strprintf(_("couldn't parse filter expression `%s': %s"), ignore_expr.c_str(), m.get_parse_error().c_str()));
+		if (ignore_rssurl == "*")
+			wildcard_ignores.push_back(ignores.size());
+		else
+			ignores_by_url[ignore_rssurl].push_back(ignores.size());
 		ignores.push_back(feedurl_expr_pair(ignore_rssurl, new matcher(ignore_expr)));
 	} else if (action == "always-download") {
 		for (std::vector<std::string>::const_iterator it=params.begin();it!=params.end();++it) {
@@ -384,13 +752,28 @@ rss_ignores::~rss_ignores() {
 }
 
 bool rss_ignores::matches(rss_item* item) {
-	for (std::vector<feedurl_expr_pair>::iterator it=ignores.begin();it!=ignores.end();++it) {
-		LOG(LOG_DEBUG, "rss_ignores::matches: it->first = `%s' item->feedurl = `%s'", it->first.c_str(), item->feedurl().c_str());
-		if (it->first == "*" || item->feedurl() == it->first) {
-			if (it->second->matches(item)) {
-				LOG(LOG_DEBUG, "rss_ignores::matches: found match");
-				return true;
-			}
+	/*
+	 * only the rules for the item's feed and the ones for all feeds need to
+	 * be looked at. They are still applied in the order of the
+	 * configuration, as a rule that can't be matched throws an exception.
+	 */
+	static const std::vector<unsigned int> no_ignores;
+	const std::vector<unsigned int>& wildcard = wildcard_ignores;
+	const std::vector<unsigned int> * feed = &no_ignores;
+	std::tr1::unordered_map<std::string, std::vector<unsigned int> >::const_iterator it = ignores_by_url.find(item->feedurl());
+	if (it != ignores_by_url.end())
+		feed = &it->second;
+
+	unsigned int i = 0, j = 0;
+	while (i < wildcard.size() || j < feed->size()) {
+		unsigned int pos;
+		if (j >= feed->size() || (i < wildcard.size() && wildcard[i] < (*feed)[j]))
+			pos = wildcard[i++];
+		else
+			pos = (*feed)[j++];
+		if (ignores[pos].second->matches(item)) {
+			LOG(LOG_DEBUG, "rss_ignores::matches: found match for `%s' item->feedurl = `%s'", ignores[pos].first.c_str(), item->feedurl().c_str());
+			return true;
 		}
 	}
 	return false;
@@ -412,6 +795,14 @@ bool rss_ignores::matches_resetunread(const std::string& url) {
 	return false;
 }
 
+struct item_from_feeds {
+	item_from_feeds(const std::tr1::unordered_map<rss_feed *, unsigned long>& f) : feeds(f) { }
+	bool operator()(const std::tr1::shared_ptr<rss_item>& item) const {
+		return feeds.find(item->get_feedptr().get()) != feeds.end();
+	}
+	const std::tr1::unordered_map<rss_feed *, unsigned long>& feeds;
+};
+
 void rss_feed::update_items(std::vector<std::tr1::shared_ptr<rss_feed> >& feeds) {
 	scope_mutex lock(&item_mutex);
 	if (query.length() == 0)
@@ -419,39 +810,75 @@ void rss_feed::update_items(std::vector<std::tr1::shared_ptr<rss_feed> >& feeds)
 
 	LOG(LOG_DEBUG, "rss_feed::update_items: query = `%s'", query.c_str());
 
-
 	struct timeval tv1, tv2, tvx;
 	gettimeofday(&tv1, NULL);
 
-	matcher m(query);
+	if (!query_matcher || query_matcher->get_expression() != query) {
+		query_matcher.reset(new matcher(query));
+		query_sources.clear();
+		clear_items();
+	}
 
-	items_.clear();
+	// attributes that change without the items changing force a full update
+	bool rematch_all = query_matcher->uses_attribute(ATTR_AGE) || query_matcher->uses_attribute(ATTR_ARTICLEINDEX) || query_matcher->uses_attribute(ATTR_FEEDINDEX);
+
+	std::tr1::unordered_map<rss_feed *, unsigned long> sources;
+	std::tr1::unordered_map<rss_feed *, unsigned long> stale;
+	std::vector<matchable *> candidates;
+	std::vector<std::pair<std::tr1::shared_ptr<rss_item> *, std::tr1::shared_ptr<rss_feed> *> > candidate_ptrs;
 
 	for (std::vector<std::tr1::shared_ptr<rss_feed> >::iterator it=feeds.begin();it!=feeds.end();++it) {
 		if ((*it)->rssurl().substr(0,6) != "query:") { // don't fetch items from other query feeds!
+			unsigned long gen = (*it)->generation();
+			sources[it->get()] = gen;
+			std::tr1::unordered_map<rss_feed *, unsigned long>::iterator old = query_sources.find(it->get());
+			if (!rematch_all && old != query_sources.end() && old->second == gen)
+				continue;
+			stale[it->get()] = gen;
 			for (std::vector<std::tr1::shared_ptr<rss_item> >::iterator jt=(*it)->items().begin();jt!=(*it)->items().end();++jt) {
-				if (m.matches(jt->get())) {
-					LOG(LOG_DEBUG, "rss_feed::update_items: matcher matches!");
-					(*jt)->set_feedptr(*it);
-					items_.push_back(*jt);
-				}
+				candidates.push_back(jt->get());
+				candidate_ptrs.push_back(std::make_pair(&*jt, &*it));
 			}
 		}
 	}
 
+	std::vector<char> results;
+	query_matcher->matches_all(candidates, results);
+
+	std::vector<std::tr1::shared_ptr<rss_item> > matched;
+	for (unsigned int i=0;i<candidates.size();++i) {
+		if (results[i]) {
+			std::tr1::shared_ptr<rss_item>& item = *candidate_ptrs[i].first;
+			item->set_feedptr(*candidate_ptrs[i].second);
+			matched.push_back(item);
+		}
+	}
+	// feeds that are gone (e.g. replaced by a reload) are stale, too
+	for (std::tr1::unordered_map<rss_feed *, unsigned long>::iterator it=query_sources.begin();it!=query_sources.end();++it) {
+		if (sources.find(it->first) == sources.end())
+			stale[it->first] = it->second;
+	}
+	query_sources.swap(sources);
+
+	LOG(LOG_DEBUG, "rss_feed::update_items: %u feeds changed, %u new matches", stale.size(), matched.size());
+
 	gettimeofday(&tvx, NULL);
 
-	std::sort(items_.begin(), items_.end());
+	if (stale.size() > 0) {
+		remove_items_if(item_from_feeds(stale));
+		merge_items(matched);
+	}
 
 	gettimeofday(&tv2, NULL);
 	unsigned long diff = (((tv2.tv_sec - tv1.tv_sec) * 1000000) + tv2.tv_usec) - tv1.tv_usec;
 	unsigned long diffx = (((tv2.tv_sec - tvx.tv_sec) * 1000000) + tv2.tv_usec) - tvx.tv_usec;
 	LOG(LOG_DEBUG, "rss_feed::update_items matching took %lu.%06lu s", diff / 1000000, diff % 1000000);
-	LOG(LOG_DEBUG, "rss_feed::update_items sorting took %lu.%06lu s", diffx / 1000000, diffx % 1000000);
+	LOG(LOG_DEBUG, "rss_feed::update_items merging took %lu.%06lu s", diffx / 1000000, diffx % 1000000);
 }
 
 void rss_feed::set_rssurl(const std::string& u) {
 	rssurl_ = u;
+	touch();
 	if (rssurl_.substr(0,6) == "query:") {
 		std::vector<std::string> tokens = utils::tokenize_quoted(u, ":");
 		if (tokens.size() < 3) {
@@ -463,51 +890,64 @@ void rss_feed::set_rssurl(const std::string& u) {
 	}
 }
 
-struct sort_item_by_title : public std::binary_function<std::tr1::shared_ptr<rss_item>, std::tr1::shared_ptr<rss_item>, bool> {
-	bool reverse;
-	sort_item_by_title(bool b) : reverse(b) { }
-	bool operator()(std::tr1::shared_ptr<rss_item> a, std::tr1::shared_ptr<rss_item> b) {
-		return reverse ?  (strcasecmp(a->title().c_str(), b->title().c_str()) > 0) : (strcasecmp(a->title().c_str(), b->title().c_str()) < 0);
-	}
-};
+enum item_sort_key { SORT_BY_NONE, SORT_BY_TITLE, SORT_BY_FLAGS, SORT_BY_AUTHOR, SORT_BY_LINK, SORT_BY_GUID, SORT_BY_DATE };
 
-struct sort_item_by_flags : public std::binary_function<std::tr1::shared_ptr<rss_item>, std::tr1::shared_ptr<rss_item>, bool> {
+/*
+ * compares two items according to an article-sort-order value. Unknown sort
+ * methods (SORT_BY_NONE) compare by date, newest first, which is the order
+ * query feeds are built in.
+ */
+struct sort_item_by {
+	item_sort_key key;
 	bool reverse;
-	sort_item_by_flags(bool b) : reverse(b) { }
-	bool operator()(std::tr1::shared_ptr<rss_item> a, std::tr1::shared_ptr<rss_item> b) {
-		return reverse ?  (strcmp(a->flags().c_str(), b->flags().c_str()) > 0) : (strcmp(a->flags().c_str(), b->flags().c_str()) < 0);
-	}
-};
 
-struct sort_item_by_author : public std::binary_function<std::tr1::shared_ptr<rss_item>, std::tr1::shared_ptr<rss_item>, bool> {
-	bool reverse;
-	sort_item_by_author(bool b) : reverse(b) { }
-	bool operator()(std::tr1::shared_ptr<rss_item> a, std::tr1::shared_ptr<rss_item> b) {
-		return reverse ?  (strcmp(a->author().c_str(), b->author().c_str()) > 0) : (strcmp(a->author().c_str(), b->author().c_str()) < 0);
-	}
-};
+	sort_item_by(const std::string& method) : key(SORT_BY_NONE), reverse(false) {
+		std::vector<std::string> methods = utils::tokenize(method,"-");
 
-struct sort_item_by_link : public std::binary_function<std::tr1::shared_ptr<rss_item>, std::tr1::shared_ptr<rss_item>, bool> {
-	bool reverse;
-	sort_item_by_link(bool b) : reverse(b) { }
-	bool operator()(std::tr1::shared_ptr<rss_item> a, std::tr1::shared_ptr<rss_item> b) {
-		return reverse ?  (strcmp(a->link().c_str(), b->link().c_str()) >  0) : (strcmp(a->link().c_str(), b->link().c_str()) < 0);
-	}
-};
+		if (methods.size() > 0 && methods[0] == "date") { // date is descending by default
+			if (methods.size() > 1 && methods[1] == "asc") {
+				reverse = true;
+			}
+		} else { // all other sort methods are ascending by default
+			if (methods.size() > 1 && methods[1] == "desc") {
+				reverse = true;
+			}
+		}
 
-struct sort_item_by_guid : public std::binary_function<std::tr1::shared_ptr<rss_item>, std::tr1::shared_ptr<rss_item>, bool> {
-	bool reverse;
-	sort_item_by_guid(bool b) : reverse(b) { }
-	bool operator()(std::tr1::shared_ptr<rss_item> a, std::tr1::shared_ptr<rss_item> b) {
-		return reverse ?  (strcmp(a->guid().c_str(), b->guid().c_str()) > 0) : (strcmp(a->guid().c_str(), b->guid().c_str()) < 0);
+		if (methods.size() > 0) {
+			if (methods[0] == "title") {
+				key = SORT_BY_TITLE;
+			} else if (methods[0] == "flags") {
+				key = SORT_BY_FLAGS;
+			} else if (methods[0] == "author") {
+				key = SORT_BY_AUTHOR;
+			} else if (methods[0] == "link") {
+				key = SORT_BY_LINK;
+			} else if (methods[0] == "guid") {
+				key = SORT_BY_GUID;
+			} else if (methods[0] == "date") {
+				key = SORT_BY_DATE;
+			}
+		}
 	}
-};
 
-struct sort_item_by_date : public std::binary_function<std::tr1::shared_ptr<rss_item>, std::tr1::shared_ptr<rss_item>, bool> {
-	bool reverse;
-	sort_item_by_date(bool b) : reverse(b) { }
-	bool operator()(std::tr1::shared_ptr<rss_item> a, std::tr1::shared_ptr<rss_item> b) {
-		return reverse ?  (a->pubDate_timestamp() > b->pubDate_timestamp()) : (a->pubDate_timestamp() < b->pubDate_timestamp());
+	bool operator()(const std::tr1::shared_ptr<rss_item>& a, const std::tr1::shared_ptr<rss_item>& b) const {
+		switch (key) {
+			case SORT_BY_TITLE:
+				return reverse ?  (a->title_sortkey() > b->title_sortkey()) : (a->title_sortkey() < b->title_sortkey());
+			case SORT_BY_FLAGS:
+				return reverse ?  (strcmp(a->flags().c_str(), b->flags().c_str()) > 0) : (strcmp(a->flags().c_str(), b->flags().c_str()) < 0);
+			case SORT_BY_AUTHOR:
+				return reverse ?  (a->author() > b->author()) : (a->author() < b->author());
+			case SORT_BY_LINK:
+				return reverse ?  (strcmp(a->link().c_str(), b->link().c_str()) >  0) : (strcmp(a->link().c_str(), b->link().c_str()) < 0);
+			case SORT_BY_GUID:
+				return reverse ?  (strcmp(a->guid().c_str(), b->guid().c_str()) > 0) : (strcmp(a->guid().c_str(), b->guid().c_str()) < 0);
+			case SORT_BY_DATE:
+				return reverse ?  (a->pubDate_timestamp() > b->pubDate_timestamp()) : (a->pubDate_timestamp() < b->pubDate_timestamp());
+			default:
+				return *a < *b;
+		}
 	}
 };
 
@@ -517,34 +957,36 @@ void rss_feed::sort(const std::string& method) {
 }
 
 void rss_feed::sort_unlocked(const std::string& method) {
-	std::vector<std::string> methods = utils::tokenize(method,"-");
-	bool reverse = false;
+	sort_item_by comparator(method);
 
-	if (methods.size() > 0 && methods[0] == "date") { // date is descending by default
-		if (methods.size() > 1 && methods[1] == "asc") {
-			reverse = true;
-		}
-	} else { // all other sort methods are ascending by default
-		if (methods.size() > 1 && methods[1] == "desc") {
-			reverse = true;
-		}
+	// flags are the only sort key that can change after an item was added,
+	// for all others, items that are already sorted stay sorted.
+	if (method == sorted_by && comparator.key != SORT_BY_FLAGS) {
+		LOG(LOG_DEBUG, "rss_feed::sort_unlocked: items are already sorted by %s", method.c_str());
+		return;
 	}
 
-	if (methods.size() > 0) {
-		if (methods[0] == "title") {
-			std::stable_sort(items_.begin(), items_.end(), sort_item_by_title(reverse));
-		} else if (methods[0] == "flags") {
-			std::stable_sort(items_.begin(), items_.end(), sort_item_by_flags(reverse));
-		} else if (methods[0] == "author") {
-			std::stable_sort(items_.begin(), items_.end(), sort_item_by_author(reverse));
-		} else if (methods[0] == "link") {
-			std::stable_sort(items_.begin(), items_.end(), sort_item_by_link(reverse));
-		} else if (methods[0] == "guid") {
-			std::stable_sort(items_.begin(), items_.end(), sort_item_by_guid(reverse));
-		} else if (methods[0] == "date") {
-			std::stable_sort(items_.begin(), items_.end(), sort_item_by_date(reverse));
-		}
+	if (comparator.key != SORT_BY_NONE) {
+		std::stable_sort(items_.begin(), items_.end(), comparator);
+	}
+	sorted_by = method;
+}
+
+/*
+ * adds items and keeps items_ in the order of the last sort() (or in the
+ * order of update_items() if there was none), so that query feeds don't need
+ * to be sorted again after an update.
+ */
+void rss_feed::merge_items(std::vector<std::tr1::shared_ptr<rss_item> >& items) {
+	sort_item_by comparator(sorted_by);
+	std::stable_sort(items.begin(), items.end(), comparator);
+	unsigned int middle = items_.size();
+	for (std::vector<std::tr1::shared_ptr<rss_item> >::iterator it=items.begin();it!=items.end();++it) {
+		items_.push_back(*it);
+		items_guid_map.insert(std::make_pair((*it)->guid(), *it));
+		count_item(*it);
 	}
+	std::inplace_merge(items_.begin(), items_.begin() + middle, items_.end(), comparator);
 }
 
 void rss_feed::remove_old_deleted_items() {
@@ -556,18 +998,16 @@ void rss_feed::remove_old_deleted_items() {
 	ch->remove_old_deleted_items(rssurl_, guids);
 }
 
+struct item_is_deleted {
+	bool operator()(const std::tr1::shared_ptr<rss_item>& item) const {
+		return item->deleted();
+	}
+};
+
 void rss_feed::purge_deleted_items() {
 	scope_mutex lock(&item_mutex);
 	scope_measure m1("rss_feed::purge_deleted_items");
-	std::vector<std::tr1::shared_ptr<rss_item> >::iterator it=items_.begin();
-	while (it!=items_.end()) {
-		if ((*it)->deleted()) {
-			items_.erase(it);
-			it = items_.begin(); // items_ modified -> iterator invalidated
-		} else {
-			++it;
-		}
-	}
+	remove_items_if(item_is_deleted());
 }
 
 void rss_feed::set_feedptrs(std::tr1::shared_ptr<rss_feed> self) {
@@ -579,6 +1019,7 @@ void rss_feed::set_feedptrs(std::tr1::shared_ptr<rss_feed> self) {
 
 void rss_item::set_feedptr(std::tr1::shared_ptr<rss_feed> ptr) {
 	feedptr = ptr;
+	touch();
 }
 
 
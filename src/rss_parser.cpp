@@ -19,16 +19,40 @@
 namespace newsbeuter {
 
 rss_parser::rss_parser(const char * uri, cache * c, configcontainer * cfg, rss_ignores * ii, remote_api * a) 
-	: my_uri(uri), ch(c), cfgcont(cfg), skip_parsing(false), is_valid(false), ign(ii), api(a) { }
+	: my_uri(uri), ch(c), cfgcont(cfg), skip_parsing(false), is_valid(false), fetched(false), ign(ii), api(a), update_lm(false), new_lm(0), cancel(0) { }
 
 rss_parser::~rss_parser() { }
 
 std::tr1::shared_ptr<rss_feed> rss_parser::parse() {
+	fetch();
+	std::tr1::shared_ptr<rss_feed> feed = build_feed();
+	commit(feed);
+	return feed;
+}
+
+void rss_parser::fetch() {
+	/*
+	 * fetch() is the I/O-bound part of a reload: it only retrieves the raw
+	 * feed data (via HTTP, an exec: or filter: plugin, or from a local file)
+	 * and keeps it for build_feed(). No XML parsing happens here, and the
+	 * cache is only read, never written.
+	 */
+	if (!fetched) {
+		retrieve_uri(my_uri);
+		fetched = true;
+	}
+}
+
+std::tr1::shared_ptr<rss_feed> rss_parser::build_feed() {
 	std::tr1::shared_ptr<rss_feed> feed(new rss_feed(ch));
 
 	feed->set_rssurl(my_uri);
 
-	retrieve_uri(my_uri);
+	fetch();
+
+	if (!skip_parsing) {
+		parse_buffer();
+	}
 
 	if (!skip_parsing && is_valid) {
 
@@ -44,7 +68,8 @@ std::tr1::shared_ptr<rss_feed> rss_parser::parse() {
 		fill_feed_fields(feed);
 		fill_feed_items(feed);
 
-		feed->remove_old_deleted_items();
+		// all data has been moved to feed by now
+		f = rsspp::feed();
 	}
 
 	feed->set_empty(false);
@@ -52,16 +77,56 @@ std::tr1::shared_ptr<rss_feed> rss_parser::parse() {
 	return feed;
 }
 
-time_t rss_parser::parse_date(const std::string& datestr) {
-	time_t t = curl_getdate(datestr.c_str(), NULL);
-	if (t == -1) {
-		LOG(LOG_INFO, "rss_parser::parse_date: encountered t == -1, trying out W3CDTF parser...");
-		t = curl_getdate(rsspp::rss_parser::__w3cdtf_to_rfc822(datestr).c_str(), NULL);
+void rss_parser::commit(std::tr1::shared_ptr<rss_feed> feed) {
+	/*
+	 * all cache writes that result from fetching and parsing a feed are
+	 * deferred until here, so that they can be done by a single writer.
+	 */
+	if (update_lm) {
+		ch->update_lastmodified(my_uri, new_lm, new_etag);
+		update_lm = false;
+	}
+	if (!skip_parsing && is_valid) {
+		feed->remove_old_deleted_items();
 	}
-	if (t == -1) {
-		LOG(LOG_INFO, "rss_parser::parse_date: still t == -1, setting to current time");
-		t = ::time(NULL);
+}
+
+void rss_parser::parse_buffer() {
+	is_valid = false;
+	try {
+		rsspp::parser p;
+		if (filename.length() > 0) {
+			f = p.parse_file(filename);
+		} else if (buf.length() > 0) {
+			f = p.parse_buffer(buf.c_str(), buf.length(), utils::is_http_url(my_uri) ? my_uri.c_str() : NULL);
+		}
+		is_valid = true;
+	} catch (rsspp::exception& e) {
+		is_valid = false;
+		throw e;
+	}
+	// the raw data is not needed anymore once it has been parsed
+	std::string().swap(buf);
+	LOG(LOG_DEBUG, "rss_parser::parse_buffer: %s, is_valid = %s", my_uri.c_str(), is_valid ? "true" : "false");
+}
+
+time_t rss_parser::parse_date(const std::string& datestr) {
+	time_t t;
+	if (parsed_dates.lookup(datestr, t))
+		return t;
+
+	if (!utils::parse_date(datestr, t)) {
+		t = curl_getdate(datestr.c_str(), NULL);
+		if (t == -1) {
+			LOG(LOG_INFO, "rss_parser::parse_date: encountered t == -1, trying out W3CDTF parser...");
+			t = curl_getdate(rsspp::rss_parser::__w3cdtf_to_rfc822(datestr).c_str(), NULL);
+		}
+		if (t == -1) {
+			LOG(LOG_INFO, "rss_parser::parse_date: still t == -1, setting to current time");
+			return ::time(NULL);
+		}
 	}
+	parsed_dates.add(datestr, t);
 	return t;
 }
 
@@ -136,7 +201,7 @@ void rss_parser::retrieve_uri(const std::string& uri) {
 	} else if (my_uri.substr(0,6) == "query:") {
 		skip_parsing = true;
 	} else if (my_uri.substr(0,7) == "file://") {
-		parse_file(my_uri.substr(7, my_uri.length()-7));
+		filename = my_uri.substr(7, my_uri.length()-7);
 	} else
 		throw utils::strprintf(_("Error: unsupported URL: %s"), my_uri.c_str());
 }
@@ -146,7 +211,7 @@ void rss_parser::download_http(const std::string& uri) {
 	char * proxy = NULL;
 	char * proxy_auth = NULL;
 	std::string proxy_type;
-	is_valid = false;
+	bool downloaded = false;
 
 	if (cfgcont->get_configvalue_as_bool("use-proxy") == true) {
 		proxy = const_cast<char *>(cfgcont->get_configvalue("proxy").c_str());
@@ -154,74 +219,65 @@ void rss_parser::download_http(const std::string& uri) {
 		proxy_type = cfgcont->get_configvalue("proxy-type");
 	}
 
-	for (unsigned int i=0;i<retrycount && !is_valid;i++) {
-		try {
-			std::string useragent = utils::get_useragent(cfgcont);
-			LOG(LOG_DEBUG, "rss_parser::download_http: user-agent = %s", useragent.c_str());
-			rsspp::parser p(cfgcont->get_configvalue_as_int("download-timeout"), useragent.c_str(), proxy, proxy_auth, utils::get_proxy_type(proxy_type));
-			time_t lm = 0;
-			std::string etag;
-			if (!ign || !ign->matches_lastmodified(uri)) {
-				ch->fetch_lastmodified(uri, lm, etag);
-			}
-			f = p.parse_url(uri, lm, etag, api);
-			if (p.get_last_modified() != 0 || p.get_etag().length() > 0) {
-				LOG(LOG_DEBUG, "rss_parser::download_http: lastmodified old: %d new: %d", lm, p.get_last_modified());
-				LOG(LOG_DEBUG, "rss_parser::download_http: etag old: %s new %s", etag.c_str(), p.get_etag().c_str());
-				ch->update_lastmodified(uri, (p.get_last_modified() != lm) ? p.get_last_modified() : 0 , (etag != p.get_etag()) ? p.get_etag() : "");
-			}
-			is_valid = true;
-		} catch (rsspp::exception& e) {
-			is_valid = false;
-			throw e;
+	for (unsigned int i=0;i<retrycount && !downloaded;i++) {
+		std::string useragent = utils::get_useragent(cfgcont);
+		LOG(LOG_DEBUG, "rss_parser::download_http: user-agent = %s", useragent.c_str());
+		rsspp::parser p(cfgcont->get_configvalue_as_int("download-timeout"), useragent.c_str(), proxy, proxy_auth, utils::get_proxy_type(proxy_type));
+		p.set_cancel_token(cancel);
+		time_t lm = 0;
+		std::string etag;
+		if (!ign || !ign->matches_lastmodified(uri)) {
+			ch->fetch_lastmodified(uri, lm, etag);
+		}
+		buf = p.fetch_url(uri, lm, etag, api);
+		if (p.get_last_modified() != 0 || p.get_etag().length() > 0) {
+			LOG(LOG_DEBUG, "rss_parser::download_http: lastmodified old: %d new: %d", lm, p.get_last_modified());
+			LOG(LOG_DEBUG, "rss_parser::download_http: etag old: %s new %s", etag.c_str(), p.get_etag().c_str());
+			update_lm = true;
+			new_lm = (p.get_last_modified() != lm) ? p.get_last_modified() : 0;
+			new_etag = (etag != p.get_etag()) ? p.get_etag() : "";
 		}
+		downloaded = true;
 	}
-	LOG(LOG_DEBUG, "rss_parser::parse: http URL %s, is_valid = %s", uri.c_str(), is_valid ? "true" : "false");
+	LOG(LOG_DEBUG, "rss_parser::download_http: http URL %s, %u bytes", uri.c_str(), buf.length());
 }
 
-void rss_parser::get_execplugin(const std::string& plugin) {
-	std::string buf = utils::get_command_output(plugin);
-	is_valid = false;
-	try {
-		rsspp::parser p;
-		f = p.parse_buffer(buf.c_str(), buf.length());
-		is_valid = true;
-	} catch (rsspp::exception& e) {
-		is_valid = false;
-		throw e;
-	}
-	LOG(LOG_DEBUG, "rss_parser::parse: execplugin %s, is_valid = %s", plugin.c_str(), is_valid ? "true" : "false");
+/*
+ * a plugin that was killed because the reload was cancelled leaves
+ * incomplete output behind, which mustn't be parsed.
+ */
+void rss_parser::check_cancelled() {
+	if (cancel && cancel->is_cancelled())
+		throw std::string(_("reload was cancelled"));
 }
 
-void rss_parser::parse_file(const std::string& file) {
-	is_valid = false;
-	try {
-		rsspp::parser p;
-		f = p.parse_file(file);
-		is_valid = true;
-	} catch (rsspp::exception& e) {
-		is_valid = false;
-		throw e;
-	}
-	LOG(LOG_DEBUG, "rss_parser::parse: parsed file %s, is_valid = %s", file.c_str(), is_valid ? "true" : "false");
+/*
+ * the same goes for a plugin that was killed because it ran into the
+ * timeout; the reload counts as failed then.
+ */
+void rss_parser::check_plugin_killed(bool killed) {
+	check_cancelled();
+	if (killed)
+		throw std::string(_("plugin timed out"));
+}
+
+void rss_parser::get_execplugin(const std::string& plugin) {
+	char * argv[4] = { const_cast<char *>("/bin/sh"), const_cast<char *>("-c"), const_cast<char *>(plugin.c_str()), NULL };
+	bool killed = false;
+	buf = utils::run_program(argv, "", cfgcont->get_configvalue_as_int("plugin-timeout"), cancel, &killed);
+	check_plugin_killed(killed);
+	LOG(LOG_DEBUG, "rss_parser::get_execplugin: execplugin %s, %u bytes", plugin.c_str(), buf.length());
 }
 
 void rss_parser::download_filterplugin(const std::string& filter, const std::string& uri) {
-	std::string buf = utils::retrieve_url(uri, cfgcont);
+	std::string input = utils::retrieve_url(uri, cfgcont, NULL, cancel);
+	check_cancelled();
 
 	char * argv[4] = { const_cast<char *>("/bin/sh"), const_cast<char *>("-c"), const_cast<char *>(filter.c_str()), NULL };
-	std::string result = utils::run_program(argv, buf);
-	LOG(LOG_DEBUG, "rss_parser::parse: output of `%s' is: %s", filter.c_str(), result.c_str());
-	is_valid = false;
-	try {
-		rsspp::parser p;
-		f = p.parse_buffer(result.c_str(), result.length());
-		is_valid = true;
-	} catch (rsspp::exception& e) {
-		is_valid = false;
-		throw e;
-	}
-	LOG(LOG_DEBUG, "rss_parser::parse: filterplugin %s, is_valid = %s", filter.c_str(), is_valid ? "true" : "false");
+	bool killed = false;
+	buf = utils::run_program(argv, input, cfgcont->get_configvalue_as_int("plugin-timeout"), cancel, &killed);
+	check_plugin_killed(killed);
+	LOG(LOG_DEBUG, "rss_parser::download_filterplugin: output of `%s' is: %s", filter.c_str(), buf.c_str());
 }
 
 void rss_parser::fill_feed_fields(std::tr1::shared_ptr<rss_feed> feed) {
@@ -252,6 +308,8 @@ void rss_parser::fill_feed_items(std::tr1::shared_ptr<rss_feed> feed) {
 	/*
 	 * we iterate over all items of a feed, create an rss_item object for
 	 * each item, and fill it with the appropriate values from the data structure.
+	 * The item's strings are moved rather than copied where possible, so
+	 * the rsspp::item is left in an unspecified state and freed right away.
 	 */
 	for (std::vector<rsspp::item>::iterator item=f.items.begin();item!=f.items.end();item++) {
 		std::tr1::shared_ptr<rss_item> x(new rss_item(ch));
@@ -291,16 +349,18 @@ void rss_parser::fill_feed_items(std::tr1::shared_ptr<rss_feed> feed) {
 		else
 			x->set_pubDate(::time(NULL));
 			
-		x->set_guid(get_guid(*item));
+		set_item_guid(x, *item);
 
-		x->set_base(item->base);
+		x->take_base(item->base);
 
 		set_item_enclosure(x, *item);
 
-		LOG(LOG_DEBUG, "rss_parser::parse: item title = `%s' link = `%s' pubDate = `%s' (%d) description = `%s'", x->title().c_str(), 
-			x->link().c_str(), x->pubDate().c_str(), x->pubDate_timestamp(), x->description().c_str());
+		LOG(LOG_DEBUG, "rss_parser::parse: item title = `%s' link = `%s' pubDate = `%s' (%d) description = `%s'", x->title_raw().c_str(), 
+			x->link().c_str(), x->pubDate().c_str(), x->pubDate_timestamp(), x->description_raw().c_str());
 
 		add_item_to_feed(feed, x);
+
+		*item = rsspp::item();
 	}
 }
 
@@ -310,7 +370,7 @@ void rss_parser::set_item_title(std::tr1::shared_ptr<rss_feed> feed, std::tr1::s
 	} else {
 		std::string title = item.title;
 		replace_newline_characters(title);
-		x->set_title(title);
+		x->take_title(title);
 	}
 }
 
@@ -326,7 +386,7 @@ void rss_parser::set_item_author(std::tr1::shared_ptr<rss_item> x, rsspp::item&
 			x->set_author(f.dc_creator);
 		}
 	} else {
-		x->set_author(item.author);
+		x->take_author(item.author);
 	}
 }
 
@@ -336,17 +396,23 @@ void rss_parser::set_item_content(std::tr1::shared_ptr<rss_item> x, rsspp::item&
 
 	handle_itunes_summary(x, item);
 
-	if (x->description() == "") {
-		x->set_description(item.description);
+	if (x->description_raw() == "") {
+		x->take_description(item.description);
 	} else {
-		if (cfgcont->get_configvalue_as_bool("always-display-description") && item.description != "")
-			x->set_description(x->description() + "<hr>" + item.description);
+		if (cfgcont->get_configvalue_as_bool("always-display-description") && item.description != "") {
+			std::string desc;
+			desc.reserve(x->description_raw().length() + 4 + item.description.length());
+			desc.append(x->description_raw());
+			desc.append("<hr>");
+			desc.append(item.description);
+			x->take_description(desc);
+		}
 	}
-	LOG(LOG_DEBUG, "rss_parser::set_item_content: content = %s", x->description().c_str());
+	LOG(LOG_DEBUG, "rss_parser::set_item_content: content = %s", x->description_raw().c_str());
 }
 
 
-std::string rss_parser::get_guid(rsspp::item& item) {
+void rss_parser::set_item_guid(std::tr1::shared_ptr<rss_item> x, rsspp::item& item) {
 	/*
 	 * We try to find a GUID (some unique identifier) for an item. If the regular
 	 * GUID is not available (oh, well, there are a few broken feeds around, after
@@ -355,13 +421,13 @@ std::string rss_parser::get_guid(rsspp::item& item) {
 	 * link changes.
 	 */
 	if (item.guid != "")
-		return item.guid;
+		x->take_guid(item.guid);
 	else if (item.link != "")
-		return item.link;
+		x->set_guid(item.link);
 	else if (item.title != "")
-		return item.title;
+		x->set_guid(item.title);
 	else
-		return "";	// too bad.
+		x->set_guid("");	// too bad.
 }
 
 void rss_parser::set_item_enclosure(std::tr1::shared_ptr<rss_item> x, rsspp::item& item) {
@@ -374,35 +440,36 @@ void rss_parser::set_item_enclosure(std::tr1::shared_ptr<rss_item> x, rsspp::ite
 void rss_parser::add_item_to_feed(std::tr1::shared_ptr<rss_feed> feed, std::tr1::shared_ptr<rss_item> item) {
 	// only add item to feed if it isn't on the ignore list or if there is no ignore list
 	if (!ign || !ign->matches(item.get())) {
-		feed->items().push_back(item);
-		LOG(LOG_INFO, "rss_parser::parse: added article title = `%s' link = `%s' ign = %p", item->title().c_str(), item->link().c_str(), ign);
+		feed->add_item(item);
+		LOG(LOG_INFO, "rss_parser::parse: added article title = `%s' link = `%s' ign = %p", item->title_raw().c_str(), item->link().c_str(), ign);
 	} else {
-		LOG(LOG_INFO, "rss_parser::parse: ignored article title = `%s' link = `%s'", item->title().c_str(), item->link().c_str());
+		LOG(LOG_INFO, "rss_parser::parse: ignored article title = `%s' link = `%s'", item->title_raw().c_str(), item->link().c_str());
 	}
 }
 
 void rss_parser::handle_content_encoded(std::tr1::shared_ptr<rss_item> x, rsspp::item& item) {
-	if (x->description() != "")
+	if (x->description_raw() != "")
 		return;
 
 	/* here we handle content:encoded tags that are an extension but very widespread */
 	if (item.content_encoded != "") {
-		x->set_description(item.content_encoded);
+		x->take_description(item.content_encoded);
 	} else {
 		LOG(LOG_DEBUG, "rss_parser::parse: found no content:encoded");
 	}
 }
 
 void rss_parser::handle_itunes_summary(std::tr1::shared_ptr<rss_item> x, rsspp::item& item) {
-	if (x->description() != "")
+	if (x->description_raw() != "")
 		return;
 
-	std::string summary = item.itunes_summary;
-	if (summary != "") {
-		std::string desc = "<ituneshack>";
-		desc.append(summary);
+	if (item.itunes_summary != "") {
+		std::string desc;
+		desc.reserve(item.itunes_summary.length() + 27);
+		desc.append("<ituneshack>");
+		desc.append(item.itunes_summary);
 		desc.append("</ituneshack>");
-		x->set_description(desc);
+		x->take_description(desc);
 	}
 }
 
@@ -1,17 +1,26 @@
 #include <utils.h>
 #include <logger.h>
 #include <config.h>
+#include <mutex.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <fcntl.h>
 #include <iconv.h>
 #include <errno.h>
 #include <pwd.h>
 #include <libgen.h>
 #include <sys/utsname.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <strings.h>
+#include <ctype.h>
 
 #include <sstream>
+#include <map>
 #include <locale>
 #include <cwchar>
 #include <cstring>
@@ -243,13 +252,83 @@ bool utils::try_fs_lock(const std::string& lock_file, pid_t & pid) {
 }
 
 
+/*
+ * iconv descriptors are expensive to open, and convert_text is called for
+ * every title, author and description that is displayed, sorted or matched,
+ * so every thread keeps its own descriptors (an iconv_t must not be used by
+ * two threads at once), keyed by (tocode, fromcode). A failed iconv_open is
+ * remembered as well.
+ */
+
+typedef std::map<std::pair<std::string, std::string>, iconv_t> iconv_cache;
+
+static pthread_key_t iconv_cache_key;
+static pthread_once_t iconv_cache_once = PTHREAD_ONCE_INIT;
+
+static void free_iconv_cache(void * ptr) {
+	iconv_cache * cache = static_cast<iconv_cache *>(ptr);
+	for (iconv_cache::iterator it=cache->begin();it!=cache->end();++it) {
+		if (it->second != reinterpret_cast<iconv_t>(-1))
+			iconv_close(it->second);
+	}
+	delete cache;
+}
+
+static void create_iconv_cache_key() {
+	pthread_key_create(&iconv_cache_key, free_iconv_cache);
+}
+
+static iconv_t get_iconv(const std::string& tocode, const std::string& fromcode) {
+	pthread_once(&iconv_cache_once, create_iconv_cache_key);
+	iconv_cache * cache = static_cast<iconv_cache *>(pthread_getspecific(iconv_cache_key));
+	if (!cache) {
+		cache = new iconv_cache;
+		pthread_setspecific(iconv_cache_key, cache);
+	}
+
+	std::pair<std::string, std::string> key(tocode, fromcode);
+	iconv_cache::iterator it = cache->find(key);
+	if (it != cache->end()) {
+		// reset the conversion state left behind by the previous use
+		::iconv(it->second, NULL, NULL, NULL, NULL);
+		return it->second;
+	}
+
+	iconv_t cd = ::iconv_open((tocode + "//TRANSLIT").c_str(), fromcode.c_str());
+	(*cache)[key] = cd;
+	return cd;
+}
+
+/*
+ * ASCII text is the same in all of these encodings, so there's nothing to
+ * convert if the text is pure ASCII.
+ */
+static bool is_ascii_compatible(const std::string& code) {
+	const char * c = code.c_str();
+	return strcasecmp(c, "utf-8")==0 || strcasecmp(c, "utf8")==0 || strcasecmp(c, "ansi_x3.4-1968")==0 ||
+		strcasecmp(c, "ascii")==0 || strcasecmp(c, "us-ascii")==0 ||
+		strncasecmp(c, "iso-8859-", 9)==0 || strncasecmp(c, "iso8859-", 8)==0 ||
+		strncasecmp(c, "windows-125", 11)==0 || strncasecmp(c, "cp125", 5)==0 || strncasecmp(c, "koi8-", 5)==0;
+}
+
+static bool is_ascii(const std::string& text) {
+	for (std::string::const_iterator it=text.begin();it!=text.end();++it) {
+		if (*it == '\0' || (*it & 0x80))
+			return false;
+	}
+	return true;
+}
+
 std::string utils::convert_text(const std::string& text, const std::string& tocode, const std::string& fromcode) {
 	std::string result;
 
 	if (strcasecmp(tocode.c_str(), fromcode.c_str())==0)
 		return text;
 
-	iconv_t cd = ::iconv_open((tocode + "//TRANSLIT").c_str(), fromcode.c_str());
+	if (is_ascii(text) && is_ascii_compatible(tocode) && is_ascii_compatible(fromcode))
+		return text;
+
+	iconv_t cd = get_iconv(tocode, fromcode);
 
 	if (cd == reinterpret_cast<iconv_t>(-1))
 		return result;
@@ -266,12 +345,13 @@ std::string utils::convert_text(const std::string& text, const std::string& toco
 #else
 	char * inbufp;
 #endif
-	char outbuf[16];
+	char outbuf[4096];
 	char * outbufp = outbuf;
 
 	outbytesleft = sizeof(outbuf);
 	inbufp = const_cast<char *>(text.c_str()); // evil, but spares us some trouble
 	inbytesleft = strlen(inbufp);
+	result.reserve(inbytesleft);
 
 	do {
 		char * old_outbufp = outbufp;
@@ -282,17 +362,16 @@ std::string utils::convert_text(const std::string& text, const std::string& toco
 					result.append(old_outbufp, outbufp - old_outbufp);
 					outbufp = outbuf;
 					outbytesleft = sizeof(outbuf);
-					inbufp += strlen(inbufp) - inbytesleft;
-					inbytesleft = strlen(inbufp);
 					break;
 				case EILSEQ:
 				case EINVAL:
 					result.append(old_outbufp, outbufp - old_outbufp);
 					result.append("?");
-					inbufp += strlen(inbufp) - inbytesleft + 1;
-					inbytesleft = strlen(inbufp);
+					inbufp++;
+					inbytesleft--;
 					break;
 				default:
+					inbytesleft = 0;
 					break;
 			}
 		} else {
@@ -300,8 +379,6 @@ std::string utils::convert_text(const std::string& text, const std::string& toco
 		}
 	} while (inbytesleft > 0);
 
-	iconv_close(cd);
-
 	return result;
 }
 
@@ -334,7 +411,20 @@ static size_t my_write_data(void *buffer, size_t size, size_t nmemb, void *userp
 	return size * nmemb;
 }
 
-std::string utils::retrieve_url(const std::string& url, configcontainer * cfgcont, const char * authinfo) {
+static int cancel_xferinfo(void * clientp, curl_off_t /* dltotal */, curl_off_t /* dlnow */, curl_off_t /* ultotal */, curl_off_t /* ulnow */) {
+	// returning non-zero makes libcurl abort the transfer with CURLE_ABORTED_BY_CALLBACK
+	return static_cast<cancel_token *>(clientp)->is_cancelled() ? 1 : 0;
+}
+
+void utils::set_curl_cancel_token(CURL * handle, cancel_token * cancel) {
+	if (!cancel)
+		return;
+	curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 0L);
+	curl_easy_setopt(handle, CURLOPT_XFERINFOFUNCTION, cancel_xferinfo);
+	curl_easy_setopt(handle, CURLOPT_XFERINFODATA, cancel);
+}
+
+std::string utils::retrieve_url(const std::string& url, configcontainer * cfgcont, const char * authinfo, cancel_token * cancel) {
 	std::string buf;
 
 	CURL * easyhandle = curl_easy_init();
@@ -342,6 +432,7 @@ std::string utils::retrieve_url(const std::string& url, configcontainer * cfgcon
 	curl_easy_setopt(easyhandle, CURLOPT_URL, url.c_str());
 	curl_easy_setopt(easyhandle, CURLOPT_WRITEFUNCTION, my_write_data);
 	curl_easy_setopt(easyhandle, CURLOPT_WRITEDATA, &buf);
+	set_curl_cancel_token(easyhandle, cancel);
 
 	if (authinfo) {
 		curl_easy_setopt(easyhandle, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
@@ -378,39 +469,183 @@ void utils::run_command(const std::string& cmd, const std::string& input) {
 	}
 }
 
-std::string utils::run_program(char * argv[], const std::string& input) {
+/*
+ * Several plugins may be run at the same time from different reload threads,
+ * and other threads fork() browsers and pagers through system(). The pipes
+ * are created close-on-exec, so that no other child inherits (and keeps open)
+ * the pipe ends of a plugin. pipe2() does that atomically; where it isn't
+ * available, the pipes are created and flagged under a lock, which at least
+ * covers the other run_program() calls.
+ */
+static mutex run_program_mtx;
+
+#define CANCEL_POLL_MS 100
+
+static void set_fd_flags(int fd, int fdflags, int flflags) {
+	if (fdflags)
+		::fcntl(fd, F_SETFD, ::fcntl(fd, F_GETFD) | fdflags);
+	if (flflags)
+		::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | flflags);
+}
+
+static int cloexec_pipe(int fds[2]) {
+#ifdef O_CLOEXEC
+	if (::pipe2(fds, O_CLOEXEC) == 0)
+		return 0;
+	if (errno != ENOSYS)
+		return -1;
+#endif
+	if (::pipe(fds) != 0)
+		return -1;
+	set_fd_flags(fds[0], FD_CLOEXEC, 0);
+	set_fd_flags(fds[1], FD_CLOEXEC, 0);
+	return 0;
+}
+
+std::string utils::run_program(char * argv[], const std::string& input, unsigned int timeout, cancel_token * cancel, bool * killed_out) {
 	std::string buf;
 	int ipipe[2]; int opipe[2];
-	pipe(ipipe);  pipe(opipe);
+	pid_t pid;
+
+	{
+		scope_mutex lock(&run_program_mtx);
+		if (cloexec_pipe(ipipe) != 0)
+			return buf;
+		if (cloexec_pipe(opipe) != 0) {
+			close(ipipe[0]); close(ipipe[1]);
+			return buf;
+		}
+		pid = fork();
+		if (pid == 0) { // child:
+			// a process group of its own, so that a timeout kills everything the program started
+			setpgid(0, 0);
+			int errfd = ::open("/dev/null", O_WRONLY);
+			dup2(ipipe[0], 0); dup2(opipe[1], 1);
+			close(2);
+			if (errfd != -1) dup2(errfd, 2);
 
-	int errfd = ::open("/dev/null", O_WRONLY);
+			execvp(argv[0], argv);
+			_exit(1);
+		}
+	}
 
-	int rc = fork();
-	switch (rc) {
-		case -1: break;
-		case 0: { // child:
-				close(ipipe[1]);   close(opipe[0]);
-				dup2(ipipe[0], 0); dup2(opipe[1], 1);
-				close(2);
-				if (errfd != -1) dup2(errfd, 2);
+	close(ipipe[0]); close(opipe[1]);
+	if (pid == -1) {
+		close(ipipe[1]); close(opipe[0]);
+		return buf;
+	}
+	setpgid(pid, pid); // the child may not have got there yet
+
+	/*
+	 * Feeding the input and collecting the output is done in one poll() loop
+	 * instead of writing everything first: a program that starts writing
+	 * before it has read all of its input would otherwise fill up the output
+	 * pipe and dead-lock with us.
+	 */
+	int infd = ipipe[1], outfd = opipe[0];
+	set_fd_flags(infd, 0, O_NONBLOCK);
+	set_fd_flags(outfd, 0, O_NONBLOCK);
+
+	std::string::size_type written = 0;
+	if (input.length() == 0) {
+		close(infd);
+		infd = -1;
+	}
 
-				execvp(argv[0], argv);
-				exit(1);
+	time_t deadline = timeout > 0 ? ::time(NULL) + timeout : 0;
+	bool killed = false;
+	char cbuf[4096];
+
+	while (outfd != -1) {
+		int wait_ms = -1;
+		if (deadline > 0) {
+			time_t now = ::time(NULL);
+			if (now >= deadline) {
+				LOG(LOG_WARN, "utils::run_program: %s timed out after %u seconds, killing process group %d", argv[0], timeout, static_cast<int>(pid));
+				::kill(-pid, SIGKILL);
+				killed = true;
+				break;
+			}
+			wait_ms = (deadline - now) * 1000;
+		}
+		if (cancel) {
+			if (cancel->is_cancelled()) {
+				LOG(LOG_INFO, "utils::run_program: %s was cancelled, killing process group %d", argv[0], static_cast<int>(pid));
+				::kill(-pid, SIGKILL);
+				killed = true;
+				break;
 			}
+			// the token can't wake up poll(), so it is checked regularly
+			if (wait_ms < 0 || wait_ms > CANCEL_POLL_MS)
+				wait_ms = CANCEL_POLL_MS;
+		}
+
+		struct pollfd fds[2];
+		nfds_t nfds = 0;
+		fds[nfds].fd = outfd;
+		fds[nfds].events = POLLIN;
+		nfds++;
+		if (infd != -1) {
+			fds[nfds].fd = infd;
+			fds[nfds].events = POLLOUT;
+			nfds++;
+		}
+
+		int rc = ::poll(fds, nfds, wait_ms);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			LOG(LOG_ERROR, "utils::run_program: poll failed: %s", strerror(errno));
 			break;
-		default: {
-				close(ipipe[0]); close(opipe[1]);
-				write(ipipe[1], input.c_str(), input.length());
-				close(ipipe[1]);
-				char cbuf[1024];
-				int rc2;
-				while ((rc2 = read(opipe[0], cbuf, sizeof(cbuf))) > 0) {
-					buf.append(cbuf, rc2);
-				}
-				close(opipe[0]);
+		}
+
+		if (fds[0].revents) {
+			ssize_t n = ::read(outfd, cbuf, sizeof(cbuf));
+			if (n > 0) {
+				buf.append(cbuf, n);
+			} else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+				close(outfd);
+				outfd = -1;
+			}
+		}
+
+		if (infd != -1 && fds[1].revents) {
+			ssize_t n = ::write(infd, input.data() + written, input.length() - written);
+			if (n > 0)
+				written += n;
+			if ((n < 0 && errno != EAGAIN && errno != EINTR) || written == input.length()) {
+				close(infd);
+				infd = -1;
 			}
+		}
+	}
+
+	if (infd != -1)
+		close(infd);
+	if (outfd != -1)
+		close(outfd);
+
+	/*
+	 * reap the child (unless the SIGCHLD handler already did). A program
+	 * that closed its output but doesn't exit is killed at the deadline or
+	 * when it is cancelled.
+	 */
+	for (;;) {
+		pid_t rc = ::waitpid(pid, NULL, (killed || (deadline == 0 && !cancel)) ? 0 : WNOHANG);
+		if (rc == pid || (rc < 0 && errno != EINTR))
 			break;
+		if (rc == 0) {
+			if ((deadline > 0 && ::time(NULL) >= deadline) || (cancel && cancel->is_cancelled())) {
+				LOG(LOG_WARN, "utils::run_program: %s timed out or was cancelled, killing process group %d", argv[0], static_cast<int>(pid));
+				::kill(-pid, SIGKILL);
+				killed = true;
+			} else {
+				::usleep(10000);
+			}
+		}
 	}
+	if (killed_out)
+		*killed_out = killed;
 	return buf;
 }
 
@@ -799,4 +1034,185 @@ std::string utils::unescape_url(const std::string& url) {
 }
 
 
+/*
+ * parse_date is a fast path for the date formats that almost all feeds use:
+ * RFC 822 ("Tue, 30 Dec 2008 12:34:56 +0100", the day name and the seconds
+ * being optional) and W3CDTF/ISO 8601 ("2008-12-30T12:34:56Z", with an
+ * optional fraction of a second and numeric offset). It returns false for
+ * anything else, so that the caller can fall back to curl_getdate.
+ */
+
+static bool parse_digits(const char *& p, unsigned int n, int& value) {
+	value = 0;
+	for (unsigned int i=0;i<n;i++) {
+		if (p[i] < '0' || p[i] > '9')
+			return false;
+		value = value * 10 + (p[i] - '0');
+	}
+	p += n;
+	return true;
+}
+
+// days since 1970-01-01 in the proleptic Gregorian calendar
+static long days_from_civil(int y, int m, int d) {
+	y -= m <= 2;
+	long era = (y >= 0 ? y : y - 399) / 400;
+	long yoe = y - era * 400;
+	long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+static bool make_time(int year, int mon, int mday, int hour, int min, int sec, int offset, time_t& t) {
+	if (year < 1970 || year > 2999 || mon < 1 || mon > 12 || mday < 1 || mday > 31 || hour > 23 || min > 59 || sec > 59)
+		return false;
+	t = static_cast<time_t>(days_from_civil(year, mon, mday)) * 86400 + hour * 3600 + min * 60 + sec - offset;
+	return true;
+}
+
+static bool parse_hhmmss(const char *& p, int& hour, int& min, int& sec) {
+	if (!parse_digits(p, 2, hour) || *p++ != ':' || !parse_digits(p, 2, min))
+		return false;
+	sec = 0;
+	if (*p == ':') {
+		p++;
+		if (!parse_digits(p, 2, sec))
+			return false;
+	}
+	return true;
+}
+
+static bool parse_w3cdtf(const char * p, time_t& t) {
+	int year, mon, mday, hour, min, sec, offset = 0;
+	if (!parse_digits(p, 4, year) || *p++ != '-' || !parse_digits(p, 2, mon) || *p++ != '-' || !parse_digits(p, 2, mday) || *p++ != 'T')
+		return false;
+	if (!parse_hhmmss(p, hour, min, sec))
+		return false;
+	if (*p == '.') {
+		do {
+			p++;
+		} while (*p >= '0' && *p <= '9');
+	}
+	if (*p == 'Z') {
+		p++;
+	} else if (*p == '+' || *p == '-') {
+		char sign = *p++;
+		int oh, om;
+		if (!parse_digits(p, 2, oh) || *p++ != ':' || !parse_digits(p, 2, om))
+			return false;
+		offset = (oh * 60 + om) * 60;
+		if (sign == '-')
+			offset = -offset;
+	}
+	if (*p != '\0')
+		return false;
+	return make_time(year, mon, mday, hour, min, sec, offset, t);
+}
+
+static const char * months[] = { "jan", "feb", "mar", "apr", "may", "jun", "jul", "aug", "sep", "oct", "nov", "dec" };
+static const char * days[] = { "mon", "tue", "wed", "thu", "fri", "sat", "sun" };
+
+static int find_name(const char * p, const char ** names, unsigned int count) {
+	for (unsigned int i=0;i<count;i++) {
+		if (strncasecmp(p, names[i], 3)==0)
+			return i;
+	}
+	return -1;
+}
+
+struct date_zone {
+	const char * name;
+	int offset; // minutes east of UTC
+};
+
+// the zones that curl_getdate knows and feeds actually use
+static const date_zone zones[] = {
+	{ "GMT", 0 }, { "UT", 0 }, { "UTC", 0 }, { "Z", 0 },
+	{ "EST", -300 }, { "EDT", -240 }, { "CST", -360 }, { "CDT", -300 },
+	{ "MST", -420 }, { "MDT", -360 }, { "PST", -480 }, { "PDT", -420 },
+};
+
+static bool parse_rfc822(const char * p, time_t& t) {
+	int mday, mon, year, hour, min, sec, offset = 0;
+
+	if (find_name(p, days, 7) >= 0 && p[3] == ',') {
+		p += 4;
+		while (*p == ' ')
+			p++;
+	}
+
+	if (p[0] >= '0' && p[0] <= '9' && p[1] == ' ') {
+		mday = p[0] - '0';
+		p++;
+	} else if (!parse_digits(p, 2, mday)) {
+		return false;
+	}
+	if (*p++ != ' ' || (mon = find_name(p, months, 12)) < 0 || p[3] != ' ')
+		return false;
+	p += 4;
+	if (!parse_digits(p, 4, year) || *p++ != ' ' || !parse_hhmmss(p, hour, min, sec))
+		return false;
+
+	if (*p == ' ') {
+		p++;
+		if (*p == '+' || *p == '-') {
+			char sign = *p++;
+			int oh, om;
+			if (!parse_digits(p, 2, oh) || !parse_digits(p, 2, om))
+				return false;
+			offset = (oh * 60 + om) * 60;
+			if (sign == '-')
+				offset = -offset;
+		} else {
+			unsigned int i;
+			for (i=0;i<sizeof(zones)/sizeof(zones[0]);i++) {
+				size_t len = strlen(zones[i].name);
+				if (strncmp(p, zones[i].name, len)==0 && (p[len] == '\0' || p[len] == ' ')) {
+					offset = zones[i].offset * 60;
+					p += len;
+					break;
+				}
+			}
+			if (i == sizeof(zones)/sizeof(zones[0]))
+				return false;
+		}
+	}
+	while (*p == ' ')
+		p++;
+	if (*p != '\0')
+		return false;
+	return make_time(year, mon + 1, mday, hour, min, sec, offset, t);
+}
+
+
+bool utils::parse_date(const std::string& datestr, time_t& t) {
+	const char * p = datestr.c_str();
+	while (*p == ' ')
+		p++;
+	if (isdigit(p[0]) && isdigit(p[1]) && isdigit(p[2]) && isdigit(p[3]) && p[4] == '-')
+		return parse_w3cdtf(p, t);
+	return parse_rfc822(p, t);
+}
+
+date_memo::date_memo() : next(0) {
+	for (unsigned int i=0;i<SIZE;i++)
+		times[i] = -1;
+}
+
+bool date_memo::lookup(const std::string& datestr, time_t& t) {
+	for (unsigned int i=0;i<SIZE;i++) {
+		if (times[i] != -1 && dates[i] == datestr) {
+			t = times[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+void date_memo::add(const std::string& datestr, time_t t) {
+	dates[next] = datestr;
+	times[next] = t;
+	next = (next + 1) % SIZE;
+}
+
 }
@@ -165,6 +165,10 @@ void view::run() {
 		// we signal "oh, you will receive an operation soon"
 		fa->prepare();
 
+		// the formaction may have closed itself while preparing
+		if (fa != get_current_formaction())
+			continue;
+
 		if (macrocmds.size() > 0) {
 			// if there is any macro command left to process, we do so
 
@@ -443,6 +447,7 @@ void view::push_itemlist(std::tr1::shared_ptr<rss_feed> feed) {
 void view::push_itemlist(unsigned int pos) {
 	std::tr1::shared_ptr<rss_feed> feed = ctrl->get_feed(pos);
 	LOG(LOG_DEBUG, "view::push_itemlist: retrieved feed at position %d", pos);
+	ctrl->bump_reload_priority(pos);
 	push_itemlist(feed);
 	if (feed->items().size() > 0) {
 		std::tr1::shared_ptr<itemlist_formaction> itemlist = std::tr1::dynamic_pointer_cast<itemlist_formaction, formaction>(get_current_formaction());
@@ -468,7 +473,10 @@ void view::push_itemview(std::tr1::shared_ptr<rss_feed> f, const std::string& gu
 		formaction_stack.push_back(itemview);
 		current_formaction = formaction_stack_size() - 1;
 	} else {
-		std::string filename = get_ctrl()->write_temporary_item(f->get_item_by_guid(guid));
+		std::tr1::shared_ptr<rss_item> item = f->get_item_by_guid(guid);
+		if (!item)
+			return;
+		std::string filename = get_ctrl()->write_temporary_item(item);
 		open_in_pager(filename);
 		::unlink(filename.c_str());
 	}
@@ -827,6 +835,14 @@ void view::feedlist_mark_pos_if_visible(unsigned int pos) {
 	}
 }
 
+std::vector<unsigned int> view::get_visible_feed_positions() {
+	scope_mutex lock(mtx);
+	if (formaction_stack_size() > 0) {
+		return std::tr1::dynamic_pointer_cast<feedlist_formaction, formaction>(formaction_stack[0])->get_visible_positions();
+	}
+	return std::vector<unsigned int>();
+}
+
 void view::set_regexmanager(regexmanager * r) {
 	rxman = r;
 }
@@ -0,0 +1,97 @@
+#include <workerpool.h>
+#include <logger.h>
+#include <exception.h>
+
+#include <unistd.h>
+
+namespace newsbeuter {
+
+struct worker_batch {
+	worker_batch(unsigned int n) : remaining(n) { }
+	unsigned int remaining;
+	condition finished;
+};
+
+worker_pool& worker_pool::get() {
+	// never destroyed, as the worker threads keep running until exit
+	static worker_pool * pool = NULL;
+	static mutex pool_mtx;
+	scope_mutex lock(&pool_mtx);
+	if (!pool) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		pool = new worker_pool(cpus > 1 ? cpus - 1 : 0);
+	}
+	return *pool;
+}
+
+worker_pool::worker_pool(unsigned int threads) : workers(0) {
+	LOG(LOG_DEBUG, "worker_pool::worker_pool: starting %u threads", threads);
+	for (unsigned int i=0;i<threads;i++) {
+		try {
+			worker_thread * t = new worker_thread(this);
+			t->start();
+			++workers;
+		} catch (const exception& e) {
+			LOG(LOG_ERROR, "worker_pool::worker_pool: couldn't start thread: %s", e.what());
+			break;
+		}
+	}
+}
+
+void worker_pool::run(std::vector<worker_job *>& jobs) {
+	if (jobs.size() == 0)
+		return;
+
+	worker_batch batch(jobs.size());
+	{
+		scope_mutex lock(&mtx);
+		for (std::vector<worker_job *>::iterator it=jobs.begin();it!=jobs.end();++it) {
+			queue.push_back(std::make_pair(*it, &batch));
+		}
+		job_available.broadcast();
+	}
+
+	// help with the queue instead of just waiting for the workers
+	while (run_next_job())
+		;
+
+	scope_mutex lock(&mtx);
+	while (batch.remaining > 0)
+		batch.finished.wait(&mtx);
+}
+
+bool worker_pool::run_next_job() {
+	std::pair<worker_job *, worker_batch *> job;
+	{
+		scope_mutex lock(&mtx);
+		if (queue.size() == 0)
+			return false;
+		job = queue.front();
+		queue.pop_front();
+	}
+
+	job.first->run();
+
+	scope_mutex lock(&mtx);
+	if (--job.second->remaining == 0)
+		job.second->finished.broadcast();
+	return true;
+}
+
+void worker_pool::work_loop() {
+	for (;;) {
+		{
+			scope_mutex lock(&mtx);
+			while (queue.size() == 0)
+				job_available.wait(&mtx);
+		}
+		run_next_job();
+	}
+}
+
+void worker_thread::run() {
+	detach();
+	pool->work_loop();
+}
+
+}
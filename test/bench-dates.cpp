@@ -0,0 +1,133 @@
+/*
+ * bench-dates compares the two ways rss_parser::parse_date turns item dates
+ * into timestamps: the generic path (curl_getdate, and curl_getdate on the
+ * output of rsspp's W3CDTF converter if that fails) and the hand-written
+ * utils::parse_date, with and without the per-feed date_memo of recently
+ * parsed date strings. The corpus mixes the shapes that rsspp passes on: RFC 822
+ * dates as found in RSS 0.9x/2.0 feeds, and the numeric-offset RFC 822 that
+ * rsspp produces from W3CDTF dates in RSS 1.0 and Atom feeds.
+ */
+
+#include <rsspp.h>
+#include <rsspp_internal.h>
+#include <utils.h>
+
+#include <sys/time.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace newsbeuter;
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static time_t generic_parse_date(const std::string& datestr) {
+	time_t t = curl_getdate(datestr.c_str(), NULL);
+	if (t == -1)
+		t = curl_getdate(rsspp::rss_parser::__w3cdtf_to_rfc822(datestr).c_str(), NULL);
+	return t;
+}
+
+static time_t fast_parse_date(const std::string& datestr) {
+	time_t t;
+	if (!utils::parse_date(datestr, t))
+		t = generic_parse_date(datestr);
+	return t;
+}
+
+static void usage(const char * argv0) {
+	std::cerr << "usage: " << argv0 << " [-f <feeds>] [-i <items>] [-u <percent>] [-r <rounds>]" << std::endl;
+	std::cerr << "\t-f <feeds>      number of feeds (default: 200)" << std::endl;
+	std::cerr << "\t-i <items>      number of items per feed (default: 50)" << std::endl;
+	std::cerr << "\t-u <percent>    share of items with a date of their own (default: 50)" << std::endl;
+	std::cerr << "\t-r <rounds>     number of times the corpus is parsed (default: 5)" << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char * argv[]) {
+	unsigned int feeds = 200;
+	unsigned int items = 50;
+	unsigned int unique = 50;
+	unsigned int rounds = 5;
+	int c;
+
+	while ((c = ::getopt(argc, argv, "f:i:u:r:h")) != -1) {
+		switch (c) {
+			case 'f': feeds = atoi(optarg); break;
+			case 'i': items = atoi(optarg); break;
+			case 'u': unique = atoi(optarg); break;
+			case 'r': rounds = atoi(optarg); break;
+			default: usage(argv[0]);
+		}
+	}
+
+	const char * formats[] = { "%a, %d %b %Y %H:%M:%S GMT", "%a, %d %b %Y %H:%M:%S +0000", "%a, %d %b %Y %H:%M:%S -0500" };
+
+	std::vector<std::vector<std::string> > corpus(feeds);
+	unsigned long total = 0;
+	for (unsigned int f=0;f<feeds;f++) {
+		time_t t = 1262304000 + f * 60;
+		for (unsigned int i=0;i<items;i++) {
+			// items without a date of their own share the previous one,
+			// like batches of items that were published together.
+			if (i == 0 || (i * 37 + f) % 100 < unique)
+				t -= 3600;
+			char buf[64];
+			struct tm stm;
+			gmtime_r(&t, &stm);
+			strftime(buf, sizeof(buf), formats[f % 3], &stm);
+			corpus[f].push_back(buf);
+			total++;
+		}
+	}
+
+	unsigned long mismatches = 0;
+	for (unsigned int f=0;f<feeds;f++) {
+		for (std::vector<std::string>::iterator it=corpus[f].begin();it!=corpus[f].end();++it) {
+			if (fast_parse_date(*it) != generic_parse_date(*it))
+				mismatches++;
+		}
+	}
+
+	printf("%u feeds, %u items/feed, %u%% unique dates, %u rounds, %lu mismatches\n", feeds, items, unique, rounds, mismatches);
+	printf("%-10s %14s %10s\n", "path", "dates/s", "ns/date");
+
+	const char * names[] = { "generic", "fast", "fast+memo" };
+	for (unsigned int path=0;path<3;path++) {
+		time_t sum = 0;
+		double start = now();
+		for (unsigned int r=0;r<rounds;r++) {
+			for (unsigned int f=0;f<feeds;f++) {
+				date_memo memo;
+				for (std::vector<std::string>::iterator it=corpus[f].begin();it!=corpus[f].end();++it) {
+					if (path == 0) {
+						sum += generic_parse_date(*it);
+					} else if (path == 1) {
+						sum += fast_parse_date(*it);
+					} else {
+						time_t t;
+						if (!memo.lookup(*it, t)) {
+							t = fast_parse_date(*it);
+							memo.add(*it, t);
+						}
+						sum += t;
+					}
+				}
+			}
+		}
+		double elapsed = now() - start;
+		if (sum == 0 || elapsed <= 0)
+			continue;
+		printf("%-10s %14.0f %10.1f\n", names[path], total * rounds / elapsed, elapsed * 1e9 / (total * rounds));
+	}
+
+	return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * bench-ignores measures how long rss_ignores::matches takes per parsed item
+ * for a growing number of ignore-article rules. Most rules are specific to
+ * one feed (two rules per feed URL, the corpus feeds being among them), a
+ * few apply to all feeds. The "linear" column is a reference scan of all
+ * rules as rss_ignores did it before the rules were indexed by feed URL
+ * (without its per-rule debug log line); "indexed" is rss_ignores itself.
+ */
+
+#include <rss.h>
+#include <matcher.h>
+#include <utils.h>
+
+#include <sys/time.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace newsbeuter;
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static std::string feed_url(unsigned int n) {
+	return utils::strprintf("http://feed%u.example.com/rss", n);
+}
+
+static bool linear_matches(std::vector<feedurl_expr_pair>& rules, rss_item * item) {
+	for (std::vector<feedurl_expr_pair>::iterator it=rules.begin();it!=rules.end();++it) {
+		if (it->first == "*" || item->feedurl() == it->first) {
+			if (it->second->matches(item))
+				return true;
+		}
+	}
+	return false;
+}
+
+static void usage(const char * argv0) {
+	std::cerr << "usage: " << argv0 << " [-f <feeds>] [-i <items>] [-w <rules>] [-r <rounds>]" << std::endl;
+	std::cerr << "\t-f <feeds>      number of feeds (default: 200)" << std::endl;
+	std::cerr << "\t-i <items>      number of items per feed (default: 50)" << std::endl;
+	std::cerr << "\t-w <rules>      number of rules for all feeds (default: 5)" << std::endl;
+	std::cerr << "\t-r <rounds>     number of times the items are matched (default: 5)" << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char * argv[]) {
+	unsigned int feeds = 200;
+	unsigned int items = 50;
+	unsigned int wildcards = 5;
+	unsigned int rounds = 5;
+	int c;
+
+	while ((c = ::getopt(argc, argv, "f:i:w:r:h")) != -1) {
+		switch (c) {
+			case 'f': feeds = atoi(optarg); break;
+			case 'i': items = atoi(optarg); break;
+			case 'w': wildcards = atoi(optarg); break;
+			case 'r': rounds = atoi(optarg); break;
+			default: usage(argv[0]);
+		}
+	}
+
+	std::vector<std::tr1::shared_ptr<rss_item> > corpus;
+	for (unsigned int f=0;f<feeds;f++) {
+		for (unsigned int i=0;i<items;i++) {
+			std::tr1::shared_ptr<rss_item> item(new rss_item(NULL));
+			item->set_feedurl(feed_url(f));
+			// every 10th item is caught by one of its feed's rules
+			item->set_title(utils::strprintf(i % 10 == 0 ? "spam %u" : "item %u", 2 * f + i % 20 / 10));
+			item->set_author("author");
+			corpus.push_back(item);
+		}
+	}
+
+	printf("%u feeds, %u items/feed, %u rules for all feeds, %u rounds\n", feeds, items, wildcards, rounds);
+	printf("%8s %10s %14s %14s %10s\n", "rules", "ignored", "linear ns/item", "indexed ns/item", "mismatches");
+
+	unsigned int rulecounts[] = { 10, 100, 1000, 5000, 20000, 0 };
+	for (unsigned int n=0;rulecounts[n];n++) {
+		rss_ignores ign;
+		std::vector<feedurl_expr_pair> rules;
+		std::vector<std::string> params(2);
+		for (unsigned int r=0;r<rulecounts[n];r++) {
+			if (r < wildcards) {
+				params[0] = "*";
+				params[1] = utils::strprintf("author = \"troll %u\"", r);
+			} else {
+				params[0] = feed_url(r / 2);
+				params[1] = utils::strprintf("title = \"spam %u\"", r);
+			}
+			ign.handle_action("ignore-article", params);
+			rules.push_back(feedurl_expr_pair(params[0], new matcher(params[1])));
+		}
+
+		unsigned long ignored = 0, mismatches = 0;
+		for (std::vector<std::tr1::shared_ptr<rss_item> >::iterator it=corpus.begin();it!=corpus.end();++it) {
+			bool m = ign.matches(it->get());
+			if (m)
+				ignored++;
+			if (m != linear_matches(rules, it->get()))
+				mismatches++;
+		}
+
+		double elapsed[2];
+		for (unsigned int path=0;path<2;path++) {
+			unsigned long count = 0;
+			double start = now();
+			for (unsigned int r=0;r<rounds;r++) {
+				for (std::vector<std::tr1::shared_ptr<rss_item> >::iterator it=corpus.begin();it!=corpus.end();++it) {
+					if (path == 0 ? linear_matches(rules, it->get()) : ign.matches(it->get()))
+						count++;
+				}
+			}
+			elapsed[path] = now() - start;
+			if (count != ignored * rounds)
+				mismatches++;
+		}
+
+		double matched = corpus.size() * rounds;
+		printf("%8u %10lu %14.1f %14.1f %10lu\n", rulecounts[n], ignored, elapsed[0] * 1e9 / matched, elapsed[1] * 1e9 / matched, mismatches);
+
+		for (std::vector<feedurl_expr_pair>::iterator it=rules.begin();it!=rules.end();++it) {
+			delete it->second;
+		}
+	}
+
+	return 0;
+}
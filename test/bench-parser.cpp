@@ -0,0 +1,157 @@
+/*
+ * bench-parser measures rsspp::parser::parse_buffer, and with it the
+ * per-format parsers (rss_09x_parser, rss_10_parser, atom_parser), on a
+ * synthetic corpus from feed_generator. For each format it reports MB/s,
+ * items/s and the number of allocations (operator new and libxml2's
+ * malloc) per parsed item.
+ */
+
+#include <feedgen.h>
+#include <rsspp.h>
+
+#include <sys/time.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include <libxml/parser.h>
+#include <libxml/xmlmemory.h>
+
+using namespace newsbeuter;
+
+static unsigned long allocations = 0;
+
+void * operator new(size_t size) {
+	allocations++;
+	void * p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void * p) throw() {
+	free(p);
+}
+
+void * operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete[](void * p) throw() {
+	free(p);
+}
+
+// the sized variants are used instead of the above since C++14
+void operator delete(void * p, size_t) throw() {
+	free(p);
+}
+
+void operator delete[](void * p, size_t) throw() {
+	free(p);
+}
+
+static void * counting_malloc(size_t size) {
+	allocations++;
+	return malloc(size);
+}
+
+static void * counting_realloc(void * p, size_t size) {
+	allocations++;
+	return realloc(p, size);
+}
+
+static char * counting_strdup(const char * s) {
+	allocations++;
+	return strdup(s);
+}
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void usage(const char * argv0) {
+	std::cerr << "usage: " << argv0 << " [-f <feeds>] [-i <items>] [-w <words>] [-d <html %>] [-n] [-e <encoding>] [-r <rounds>]" << std::endl;
+	std::cerr << "\t-f <feeds>      number of feeds per format (default: 50)" << std::endl;
+	std::cerr << "\t-i <items>      number of items per feed (default: 20)" << std::endl;
+	std::cerr << "\t-w <words>      number of words per item description (default: 40)" << std::endl;
+	std::cerr << "\t-d <percent>    share of words wrapped in HTML markup (default: 10)" << std::endl;
+	std::cerr << "\t-n              add dc:, content: and media: elements" << std::endl;
+	std::cerr << "\t-e <encoding>   encoding of the feeds (default: UTF-8)" << std::endl;
+	std::cerr << "\t-r <rounds>     number of times the corpus is parsed (default: 5)" << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char * argv[]) {
+	feedgen_options opts;
+	unsigned int feeds = 50;
+	unsigned int rounds = 5;
+	int c;
+
+	while ((c = ::getopt(argc, argv, "f:i:w:d:ne:r:h")) != -1) {
+		switch (c) {
+			case 'f': feeds = atoi(optarg); break;
+			case 'i': opts.items = atoi(optarg); break;
+			case 'w': opts.words = atoi(optarg); break;
+			case 'd': opts.html_density = atoi(optarg); break;
+			case 'n': opts.namespaces = true; break;
+			case 'e': opts.encoding = optarg; break;
+			case 'r': rounds = atoi(optarg); break;
+			default: usage(argv[0]);
+		}
+	}
+
+	xmlMemSetup(free, counting_malloc, counting_realloc, counting_strdup);
+	xmlInitParser();
+
+	feed_generator gen(opts);
+
+	printf("%u feeds/format, %u items/feed, %u words/item, %u%% HTML, namespaces %s, %s, %u rounds\n",
+		feeds, opts.items, opts.words, opts.html_density, opts.namespaces ? "yes" : "no", opts.encoding.c_str(), rounds);
+	printf("%-8s %-8s %10s %12s %14s\n", "format", "backend", "MB/s", "items/s", "allocs/item");
+
+	rsspp::backend backends[] = { rsspp::BACKEND_DOM, rsspp::BACKEND_STREAM };
+	const char * backend_names[] = { "dom", "stream" };
+
+	for (unsigned int format=0;format<FEEDGEN_MAX;format++) {
+		std::vector<std::string> corpus;
+		double bytes = 0;
+		for (unsigned int i=0;i<feeds;i++) {
+			corpus.push_back(gen.generate(i, 0, static_cast<feedgen_format>(format)));
+			bytes += corpus.back().length();
+		}
+
+		for (unsigned int b=0;b<sizeof(backends)/sizeof(backends[0]);b++) {
+			unsigned long items = 0;
+			allocations = 0;
+			double start = now();
+			for (unsigned int r=0;r<rounds;r++) {
+				for (std::vector<std::string>::iterator it=corpus.begin();it!=corpus.end();++it) {
+					rsspp::parser p;
+					p.set_backend(backends[b]);
+					rsspp::feed f = p.parse_buffer(it->c_str(), it->length());
+					items += f.items.size();
+				}
+			}
+			double elapsed = now() - start;
+			unsigned long allocs = allocations;
+
+			if (items == 0 || elapsed <= 0) {
+				printf("%-8s %-8s no items were parsed\n", feed_generator::format_name(static_cast<feedgen_format>(format)), backend_names[b]);
+				continue;
+			}
+
+			printf("%-8s %-8s %10.2f %12.0f %14.1f\n", feed_generator::format_name(static_cast<feedgen_format>(format)), backend_names[b],
+				bytes * rounds / elapsed / (1024 * 1024), items / elapsed, static_cast<double>(allocs) / items);
+		}
+	}
+
+	xmlCleanupParser();
+
+	return 0;
+}
@@ -0,0 +1,37 @@
+#!/bin/sh
+# Reload benchmark: runs "newsbeuter -x reload" against a local fixture-server
+# and reports feeds/s and the p50/p99 per-feed latency, once with an empty
+# cache (cold) and once with a filled one (warm, mostly 304 responses).
+#
+# usage: bench-reload.sh [<feeds> [<reload-threads> [<fixture-server options>...]]]
+# e.g.:  bench-reload.sh 500 8 -l 50 -z -e 2 -c 20
+
+FEEDS=${1:-200}
+THREADS=${2:-4}
+[ $# -gt 0 ] && shift
+[ $# -gt 0 ] && shift
+PORT=${BENCH_PORT:-18080}
+DIR=`mktemp -d /tmp/bench-reload.XXXXXX`
+
+./fixture-server -p $PORT -n $FEEDS -u > $DIR/urls
+./fixture-server -p $PORT -n $FEEDS "$@" &
+SERVER=$!
+trap "kill $SERVER 2>/dev/null; rm -rf $DIR" EXIT
+sleep 1
+
+echo "reload-threads $THREADS" > $DIR/config
+
+echo "$FEEDS feeds, $THREADS reload threads, fixture-server options: $*"
+for run in cold warm ; do
+	HOME=$DIR ../newsbeuter -u $DIR/urls -c $DIR/cache.db -C $DIR/config -x reload -d $DIR/log.$run -l 5 > /dev/null
+	grep "function \`reload_job " $DIR/log.$run | sed 's/.* took \([0-9.]*\) s$/\1/' | sort -n > $DIR/latencies.$run
+	total=$(grep "function .reload_pipeline::run' took" $DIR/log.$run | sed 's/.* took \([0-9.]*\) s$/\1/')
+	awk -v run=$run -v total=$total '
+		{ lat[NR] = $1 }
+		END {
+			if (NR == 0 || total == 0) { print run ": no feeds were reloaded"; exit 1 }
+			p50 = lat[int((NR - 1) * 0.50) + 1]
+			p99 = lat[int((NR - 1) * 0.99) + 1]
+			printf("%s: %d feeds in %.3f s, %.1f feeds/s, p50 %.1f ms, p99 %.1f ms\n", run, NR, total, NR / total, p50 * 1000, p99 * 1000)
+		}' $DIR/latencies.$run
+done
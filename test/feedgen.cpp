@@ -0,0 +1,182 @@
+#include <feedgen.h>
+#include <utils.h>
+
+#include <ctime>
+
+namespace newsbeuter {
+
+// a few words with non-ASCII characters make the encoding matter.
+static const char * words[] = {
+	"lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+	"sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et",
+	"dolore", "magna", "aliqua", "enim", "ad", "minim", "veniam", "quis",
+	"nostrud", "exercitation", "ullamco", "laboris", "nisi", "aliquip", "ex", "ea",
+	"\xc3\xbc" "ber", "caf\xc3\xa9", "na\xc3\xafve", "gr\xc3\xb6\xc3\x9f" "e"
+};
+
+#define NUM_WORDS (sizeof(words)/sizeof(words[0]))
+
+// a small LCG is good enough, and unlike rand() it is reproducible everywhere.
+static unsigned int next_random(unsigned int& seed) {
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) & 0x7fff;
+}
+
+static std::string escape(const std::string& s) {
+	return utils::replace_all(utils::replace_all(utils::replace_all(s, "&", "&amp;"), "<", "&lt;"), ">", "&gt;");
+}
+
+feed_generator::feed_generator(const feedgen_options& o) : opts(o) { }
+
+const char * feed_generator::format_name(feedgen_format format) {
+	switch (format) {
+		case FEEDGEN_RSS091: return "rss091";
+		case FEEDGEN_RSS092: return "rss092";
+		case FEEDGEN_RSS10: return "rss10";
+		case FEEDGEN_RSS20: return "rss20";
+		case FEEDGEN_ATOM10: return "atom10";
+		default: return "unknown";
+	}
+}
+
+std::string feed_generator::text(unsigned int& seed, unsigned int count) {
+	std::string result;
+	for (unsigned int i=0;i<count;i++) {
+		if (i > 0)
+			result.append(" ");
+		result.append(words[next_random(seed) % NUM_WORDS]);
+	}
+	return result;
+}
+
+std::string feed_generator::html(unsigned int& seed, unsigned int count, const std::string& link) {
+	static const char * tags[] = { "b", "i", "em", "code" };
+	std::string result = "<p>";
+	for (unsigned int i=0;i<count;i++) {
+		if (i > 0)
+			result.append(i % 16 == 0 ? "</p>\n<p>" : " ");
+		std::string word = words[next_random(seed) % NUM_WORDS];
+		if (next_random(seed) % 100 < opts.html_density) {
+			unsigned int kind = next_random(seed) % 5;
+			if (kind < 4) {
+				result.append(utils::strprintf("<%s>%s</%s>", tags[kind], word.c_str(), tags[kind]));
+			} else {
+				result.append(utils::strprintf("<a href=\"%s#%u\">%s</a>", link.c_str(), i, word.c_str()));
+			}
+		} else {
+			result.append(word);
+		}
+	}
+	result.append("</p>");
+	return result;
+}
+
+std::string feed_generator::date(unsigned int id, unsigned int generation, unsigned int item, bool w3c) {
+	// newer generations and lower item numbers are more recent.
+	time_t t = 1262304000 + id * 60 + (generation * opts.items - item) * 3600;
+	char buf[64];
+	struct tm stm;
+	gmtime_r(&t, &stm);
+	strftime(buf, sizeof(buf), w3c ? "%Y-%m-%dT%H:%M:%SZ" : "%a, %d %b %Y %H:%M:%S GMT", &stm);
+	return buf;
+}
+
+std::string feed_generator::generate(unsigned int id, unsigned int generation) {
+	return generate(id, generation, format_for(id));
+}
+
+std::string feed_generator::generate(unsigned int id, unsigned int generation, feedgen_format format) {
+	unsigned int seed = id * 7919 + generation;
+	std::string link = utils::strprintf("http://example.com/feeds/%u/", id);
+	std::string title = utils::strprintf("Feed %u: %s", id, text(seed, 3).c_str());
+	std::string xmldecl = utils::strprintf("<?xml version=\"1.0\" encoding=\"%s\"?>\n", opts.encoding.c_str());
+	std::string ns = opts.namespaces ? " xmlns:dc=\"http://purl.org/dc/elements/1.1/\" xmlns:content=\"http://purl.org/rss/1.0/modules/content/\" xmlns:media=\"http://search.yahoo.com/mrss/\"" : "";
+	std::string out;
+
+	switch (format) {
+		case FEEDGEN_RSS091:
+		case FEEDGEN_RSS092:
+		case FEEDGEN_RSS20:
+			out.append(xmldecl);
+			out.append(utils::strprintf("<rss version=\"%s\"%s>\n<channel>\n",
+				format == FEEDGEN_RSS091 ? "0.91" : (format == FEEDGEN_RSS092 ? "0.92" : "2.0"), format == FEEDGEN_RSS20 ? ns.c_str() : ""));
+			out.append(utils::strprintf("<title>%s</title>\n<link>%s</link>\n<description>%s</description>\n",
+				title.c_str(), link.c_str(), text(seed, 8).c_str()));
+			break;
+		case FEEDGEN_RSS10:
+			out.append(xmldecl);
+			out.append(utils::strprintf("<rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\" xmlns=\"http://purl.org/rss/1.0/\"%s>\n",
+				opts.namespaces ? ns.c_str() : " xmlns:dc=\"http://purl.org/dc/elements/1.1/\""));
+			out.append(utils::strprintf("<channel rdf:about=\"%s\">\n<title>%s</title>\n<link>%s</link>\n<description>%s</description>\n</channel>\n",
+				link.c_str(), title.c_str(), link.c_str(), text(seed, 8).c_str()));
+			break;
+		case FEEDGEN_ATOM10:
+		default:
+			out.append(xmldecl);
+			out.append(utils::strprintf("<feed xmlns=\"http://www.w3.org/2005/Atom\"%s>\n", ns.c_str()));
+			out.append(utils::strprintf("<title type=\"text\">%s</title>\n<id>%s</id>\n<updated>%s</updated>\n<link rel=\"alternate\" type=\"text/html\" href=\"%s\" />\n",
+				title.c_str(), link.c_str(), date(id, generation, 0, true).c_str(), link.c_str()));
+			break;
+	}
+
+	for (unsigned int i=0;i<opts.items;i++) {
+		unsigned int serial = generation * opts.items + opts.items - i;
+		std::string item_link = utils::strprintf("%sitem/%u", link.c_str(), serial);
+		std::string item_title = text(seed, 6);
+		std::string author = text(seed, 2);
+		std::string desc = escape(html(seed, opts.words, item_link));
+		std::string extra;
+
+		switch (format) {
+			case FEEDGEN_RSS091:
+				out.append(utils::strprintf("<item>\n<title>%s</title>\n<link>%s</link>\n<description>%s</description>\n</item>\n",
+					item_title.c_str(), item_link.c_str(), desc.c_str()));
+				break;
+			case FEEDGEN_RSS092:
+			case FEEDGEN_RSS20:
+				if (opts.namespaces && format == FEEDGEN_RSS20) {
+					extra = utils::strprintf("<dc:creator>%s</dc:creator>\n<content:encoded><![CDATA[%s]]></content:encoded>\n<media:content url=\"%s.mp3\" type=\"audio/mpeg\" />\n",
+						author.c_str(), html(seed, opts.words, item_link).c_str(), item_link.c_str());
+				} else {
+					extra = utils::strprintf("<author>%s</author>\n", author.c_str());
+				}
+				out.append(utils::strprintf("<item>\n<title>%s</title>\n<link>%s</link>\n<guid>%s</guid>\n<pubDate>%s</pubDate>\n%s<description>%s</description>\n</item>\n",
+					item_title.c_str(), item_link.c_str(), item_link.c_str(), date(id, generation, i, false).c_str(), extra.c_str(), desc.c_str()));
+				break;
+			case FEEDGEN_RSS10:
+				if (opts.namespaces) {
+					extra = utils::strprintf("<content:encoded><![CDATA[%s]]></content:encoded>\n", html(seed, opts.words, item_link).c_str());
+				}
+				out.append(utils::strprintf("<item rdf:about=\"%s\">\n<title>%s</title>\n<link>%s</link>\n<dc:date>%s</dc:date>\n<dc:creator>%s</dc:creator>\n%s<description>%s</description>\n</item>\n",
+					item_link.c_str(), item_title.c_str(), item_link.c_str(), date(id, generation, i, true).c_str(), author.c_str(), extra.c_str(), desc.c_str()));
+				break;
+			case FEEDGEN_ATOM10:
+			default:
+				if (opts.namespaces) {
+					extra = utils::strprintf("<dc:subject>%s</dc:subject>\n<media:thumbnail url=\"%s.png\" />\n", text(seed, 1).c_str(), item_link.c_str());
+				}
+				out.append(utils::strprintf("<entry>\n<title>%s</title>\n<link rel=\"alternate\" type=\"text/html\" href=\"%s\" />\n<id>%s</id>\n<updated>%s</updated>\n<author><name>%s</name></author>\n%s<content type=\"html\">%s</content>\n</entry>\n",
+					item_title.c_str(), item_link.c_str(), item_link.c_str(), date(id, generation, i, true).c_str(), author.c_str(), extra.c_str(), desc.c_str()));
+				break;
+		}
+	}
+
+	switch (format) {
+		case FEEDGEN_RSS10:
+			out.append("</rdf:RDF>\n");
+			break;
+		case FEEDGEN_ATOM10:
+			out.append("</feed>\n");
+			break;
+		default:
+			out.append("</channel>\n</rss>\n");
+			break;
+	}
+
+	if (opts.encoding != "UTF-8")
+		out = utils::convert_text(out, opts.encoding, "UTF-8");
+
+	return out;
+}
+
+}
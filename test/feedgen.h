@@ -0,0 +1,44 @@
+#ifndef NEWSBEUTER_FEEDGEN__H
+#define NEWSBEUTER_FEEDGEN__H
+
+#include <string>
+
+namespace newsbeuter {
+
+enum feedgen_format { FEEDGEN_RSS091 = 0, FEEDGEN_RSS092, FEEDGEN_RSS10, FEEDGEN_RSS20, FEEDGEN_ATOM10, FEEDGEN_MAX };
+
+struct feedgen_options {
+	feedgen_options() : items(20), words(40), html_density(10), namespaces(false), encoding("UTF-8") { }
+	unsigned int items;
+	unsigned int words; // per item description
+	unsigned int html_density; // percentage of words that are wrapped in markup
+	bool namespaces; // add dc:, content: and media: elements
+	std::string encoding; // anything iconv can convert UTF-8 to
+};
+
+/*
+ * feed_generator produces synthetic feeds for benchmarks. The output only
+ * depends on the feed id, the generation and the options, so a feed can be
+ * regenerated at any time instead of being kept in memory.
+ */
+class feed_generator {
+	public:
+		feed_generator(const feedgen_options& o = feedgen_options());
+
+		std::string generate(unsigned int id, unsigned int generation = 0);
+		std::string generate(unsigned int id, unsigned int generation, feedgen_format format);
+
+		static feedgen_format format_for(unsigned int id) { return static_cast<feedgen_format>(id % FEEDGEN_MAX); }
+		static const char * format_name(feedgen_format format);
+
+	private:
+		std::string text(unsigned int& seed, unsigned int words);
+		std::string html(unsigned int& seed, unsigned int words, const std::string& link);
+		std::string date(unsigned int id, unsigned int generation, unsigned int item, bool w3c);
+
+		feedgen_options opts;
+};
+
+}
+
+#endif
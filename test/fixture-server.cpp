@@ -0,0 +1,299 @@
+/*
+ * fixture-server is a stand-in for testbed.newsbeuter.org that serves a
+ * generated corpus of RSS 0.91/0.92/1.0/2.0 and Atom 1.0 feeds on
+ * http://127.0.0.1:<port>/feeds/<n>.xml, so that reloads can be measured
+ * offline and reproducibly (see `make bench-reload').
+ *
+ * Latency, bandwidth, the share of failing requests and how often feeds
+ * change between requests are configurable. Feeds carry ETag and
+ * Last-Modified headers and are answered with 304 Not Modified when they
+ * haven't changed, and are gzip-compressed for clients that ask for it.
+ */
+
+#include <feedgen.h>
+#include <thread.h>
+#include <mutex.h>
+#include <utils.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <vector>
+
+#include <curl/curl.h>
+#include <zlib.h>
+
+using namespace newsbeuter;
+
+struct server_options {
+	server_options() : port(8000), feeds(100), items(20), latency(0), bandwidth(0), error_rate(0), change_rate(0), gzip(false) { }
+	unsigned short port;
+	unsigned int feeds;
+	unsigned int items;
+	unsigned int latency; // in milliseconds
+	unsigned int bandwidth; // in bytes per second, 0 means unlimited
+	unsigned int error_rate; // in percent
+	unsigned int change_rate; // in percent
+	bool gzip;
+};
+
+struct feed_state {
+	feed_state() : generation(0), cached_generation(~0U) { }
+	unsigned int generation;
+	unsigned int cached_generation;
+	std::string body;
+	std::string gzbody;
+};
+
+class fixture_server {
+	public:
+		fixture_server(const server_options& o, const feedgen_options& go) : opts(o), gen(go), state(o.feeds), seed(time(NULL)) { }
+		void serve();
+		void handle(int fd);
+	private:
+		bool get_feed(unsigned int id, bool changed, std::string& body, std::string& gzbody, unsigned int& generation);
+		unsigned int random_percent();
+		void send_response(int fd, const std::string& status, const std::string& headers, const std::string& body);
+		static std::string get_header(const std::string& request, const std::string& name);
+		static std::string http_date(time_t t);
+		static std::string gzip(const std::string& data);
+		static time_t last_modified(unsigned int generation) { return 1262304000 + generation * 3600; }
+
+		server_options opts;
+		feed_generator gen;
+		std::vector<feed_state> state;
+		unsigned int seed;
+		mutex mtx;
+};
+
+class connection_thread : public thread {
+	public:
+		connection_thread(fixture_server * s, int f) : server(s), fd(f) { }
+	protected:
+		virtual void run() {
+			server->handle(fd);
+			::close(fd);
+		}
+	private:
+		fixture_server * server;
+		int fd;
+};
+
+void fixture_server::serve() {
+	int sock = ::socket(AF_INET, SOCK_STREAM, 0);
+	if (sock < 0) {
+		perror("socket");
+		exit(EXIT_FAILURE);
+	}
+	int on = 1;
+	::setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(opts.port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (::bind(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 || ::listen(sock, 128) < 0) {
+		perror("bind");
+		exit(EXIT_FAILURE);
+	}
+
+	for (;;) {
+		int fd = ::accept(sock, NULL, NULL);
+		if (fd < 0)
+			continue;
+		connection_thread * t = new connection_thread(this, fd);
+		::pthread_detach(t->start());
+	}
+}
+
+unsigned int fixture_server::random_percent() {
+	scope_mutex lock(&mtx);
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 16) & 0x7fff) % 100;
+}
+
+bool fixture_server::get_feed(unsigned int id, bool changed, std::string& body, std::string& gzbody, unsigned int& generation) {
+	if (id >= state.size())
+		return false;
+	scope_mutex lock(&mtx);
+	feed_state& fs = state[id];
+	if (changed)
+		fs.generation++;
+	if (fs.cached_generation != fs.generation) {
+		fs.body = gen.generate(id, fs.generation);
+		fs.gzbody = opts.gzip ? gzip(fs.body) : "";
+		fs.cached_generation = fs.generation;
+	}
+	body = fs.body;
+	gzbody = fs.gzbody;
+	generation = fs.generation;
+	return true;
+}
+
+std::string fixture_server::get_header(const std::string& request, const std::string& name) {
+	std::vector<std::string> lines = utils::tokenize(request, "\r\n");
+	for (std::vector<std::string>::iterator it=lines.begin();it!=lines.end();++it) {
+		if (strncasecmp(it->c_str(), name.c_str(), name.length()) == 0 && it->length() > name.length() && (*it)[name.length()] == ':') {
+			std::string::size_type pos = it->find_first_not_of(" \t", name.length() + 1);
+			return pos == std::string::npos ? "" : it->substr(pos);
+		}
+	}
+	return "";
+}
+
+std::string fixture_server::http_date(time_t t) {
+	char buf[64];
+	struct tm stm;
+	gmtime_r(&t, &stm);
+	strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &stm);
+	return buf;
+}
+
+std::string fixture_server::gzip(const std::string& data) {
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+	if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return "";
+	std::string result(deflateBound(&zs, data.length()), '\0');
+	zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+	zs.avail_in = data.length();
+	zs.next_out = reinterpret_cast<Bytef *>(&result[0]);
+	zs.avail_out = result.length();
+	deflate(&zs, Z_FINISH);
+	result.resize(zs.total_out);
+	deflateEnd(&zs);
+	return result;
+}
+
+void fixture_server::send_response(int fd, const std::string& status, const std::string& headers, const std::string& body) {
+	std::string response = utils::strprintf("HTTP/1.1 %s\r\nContent-Length: %u\r\nConnection: close\r\n%s\r\n",
+		status.c_str(), body.length(), headers.c_str());
+	response.append(body);
+
+	// without a bandwidth limit, everything is sent at once; otherwise, a
+	// tenth of the allowed bytes is sent every 100 ms.
+	std::string::size_type chunk = opts.bandwidth > 0 ? (opts.bandwidth + 9) / 10 : response.length();
+	std::string::size_type sent = 0;
+	while (sent < response.length()) {
+		ssize_t rc = ::write(fd, response.data() + sent, std::min(chunk, response.length() - sent));
+		if (rc <= 0)
+			return;
+		sent += rc;
+		if (opts.bandwidth > 0 && sent < response.length())
+			::usleep(100000);
+	}
+}
+
+void fixture_server::handle(int fd) {
+	std::string request;
+	char buf[4096];
+	while (request.find("\r\n\r\n") == std::string::npos && request.length() < 65536) {
+		ssize_t rc = ::read(fd, buf, sizeof(buf));
+		if (rc <= 0)
+			return;
+		request.append(buf, rc);
+	}
+
+	if (opts.latency > 0)
+		::usleep(opts.latency * 1000);
+
+	unsigned int id;
+	char path[256];
+	if (sscanf(request.c_str(), "GET %255s", path) != 1 || sscanf(path, "/feeds/%u.xml", &id) != 1) {
+		send_response(fd, "404 Not Found", "", "");
+		return;
+	}
+
+	if (opts.error_rate > 0 && random_percent() < opts.error_rate) {
+		send_response(fd, "500 Internal Server Error", "", "");
+		return;
+	}
+
+	std::string body, gzbody;
+	unsigned int generation;
+	bool changed = opts.change_rate > 0 && random_percent() < opts.change_rate;
+	if (!get_feed(id, changed, body, gzbody, generation)) {
+		send_response(fd, "404 Not Found", "", "");
+		return;
+	}
+
+	std::string etag = utils::strprintf("\"%u-%u\"", id, generation);
+	time_t lm = last_modified(generation);
+	std::string headers = utils::strprintf("ETag: %s\r\nLast-Modified: %s\r\n", etag.c_str(), http_date(lm).c_str());
+
+	std::string inm = get_header(request, "If-None-Match");
+	std::string ims = get_header(request, "If-Modified-Since");
+	if ((inm != "" && inm == etag) || (inm == "" && ims != "" && curl_getdate(ims.c_str(), NULL) >= lm)) {
+		send_response(fd, "304 Not Modified", headers, "");
+		return;
+	}
+
+	headers.append("Content-Type: application/xml\r\n");
+	if (opts.gzip && get_header(request, "Accept-Encoding").find("gzip") != std::string::npos) {
+		headers.append("Content-Encoding: gzip\r\n");
+		send_response(fd, "200 OK", headers, gzbody);
+	} else {
+		send_response(fd, "200 OK", headers, body);
+	}
+}
+
+static void usage(const char * argv0) {
+	std::cerr << "usage: " << argv0 << " [-p <port>] [-n <feeds>] [-i <items>] [-l <latency ms>] [-b <bytes/s>] [-e <error %>] [-c <change %>] [-z] [-u]" << std::endl;
+	std::cerr << "\t-p <port>       port to listen on (default: 8000)" << std::endl;
+	std::cerr << "\t-n <feeds>      number of feeds (default: 100)" << std::endl;
+	std::cerr << "\t-i <items>      number of items per feed (default: 20)" << std::endl;
+	std::cerr << "\t-l <latency>    delay before each response in milliseconds" << std::endl;
+	std::cerr << "\t-b <bytes/s>    bandwidth limit per connection" << std::endl;
+	std::cerr << "\t-e <percent>    share of requests that fail with 500" << std::endl;
+	std::cerr << "\t-c <percent>    share of requests for which the feed has changed" << std::endl;
+	std::cerr << "\t-z              gzip responses if the client accepts it" << std::endl;
+	std::cerr << "\t-u              print the feed URLs and exit" << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char * argv[]) {
+	server_options opts;
+	bool print_urls = false;
+	int c;
+
+	while ((c = ::getopt(argc, argv, "p:n:i:l:b:e:c:zuh")) != -1) {
+		switch (c) {
+			case 'p': opts.port = atoi(optarg); break;
+			case 'n': opts.feeds = atoi(optarg); break;
+			case 'i': opts.items = atoi(optarg); break;
+			case 'l': opts.latency = atoi(optarg); break;
+			case 'b': opts.bandwidth = atoi(optarg); break;
+			case 'e': opts.error_rate = atoi(optarg); break;
+			case 'c': opts.change_rate = atoi(optarg); break;
+			case 'z': opts.gzip = true; break;
+			case 'u': print_urls = true; break;
+			default: usage(argv[0]);
+		}
+	}
+
+	if (print_urls) {
+		for (unsigned int i=0;i<opts.feeds;i++) {
+			std::cout << "http://127.0.0.1:" << opts.port << "/feeds/" << i << ".xml" << std::endl;
+		}
+		return 0;
+	}
+
+	::signal(SIGPIPE, SIG_IGN);
+
+	feedgen_options genopts;
+	genopts.items = opts.items;
+
+	fixture_server server(opts, genopts);
+	server.serve();
+
+	return 0;
+}
@@ -4,12 +4,24 @@
 #define BOOST_TEST_DYN_LINK
 #include <boost/test/auto_unit_test.hpp>
 
+#include <boost/test/test_case_template.hpp>
+#include <boost/mpl/list.hpp>
+
 #include <rsspp.h>
 #include <rsspp_internal.h>
 
+/*
+ * The feed parsing test cases are run against both parser backends, so that
+ * they also serve as conformance tests for the streaming parser.
+ */
+struct stream_backend { static const rsspp::backend value = rsspp::BACKEND_STREAM; };
+struct dom_backend { static const rsspp::backend value = rsspp::BACKEND_DOM; };
+typedef boost::mpl::list<stream_backend, dom_backend> backends;
+
 
-BOOST_AUTO_TEST_CASE(TestParseSimpleRSS_0_91) {
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestParseSimpleRSS_0_91, T, backends) {
 	rsspp::parser p;
+	p.set_backend(T::value);
 
 	rsspp::feed f = p.parse_file("data/rss091_1.xml");
 
@@ -27,8 +39,9 @@ BOOST_AUTO_TEST_CASE(TestParseSimpleRSS_0_91) {
 	BOOST_CHECK_EQUAL(f.items[0].guid, "");
 }
 
-BOOST_AUTO_TEST_CASE(TestParseSimpleRSS_0_92) {
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestParseSimpleRSS_0_92, T, backends) {
 	rsspp::parser p;
+	p.set_backend(T::value);
 
 	rsspp::feed f = p.parse_file("data/rss092_1.xml");
 
@@ -53,8 +66,9 @@ BOOST_AUTO_TEST_CASE(TestParseSimpleRSS_0_92) {
 	BOOST_CHECK_EQUAL(f.items[1].guid, "");
 }
 
-BOOST_AUTO_TEST_CASE(TestParseSimpleRSS_2_0) {
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestParseSimpleRSS_2_0, T, backends) {
 	rsspp::parser p;
+	p.set_backend(T::value);
 
 	rsspp::feed f = p.parse_file("data/rss20_1.xml");
 
@@ -74,8 +88,9 @@ BOOST_AUTO_TEST_CASE(TestParseSimpleRSS_2_0) {
 	BOOST_CHECK_EQUAL(f.items[0].guid_isPermaLink, false);
 }
 
-BOOST_AUTO_TEST_CASE(TestParseSimpleRSS_1_0) {
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestParseSimpleRSS_1_0, T, backends) {
 	rsspp::parser p;
+	p.set_backend(T::value);
 
 	rsspp::feed f = p.parse_file("data/rss10_1.xml");
 	BOOST_CHECK_EQUAL(f.rss_version, rsspp::RSS_1_0);
@@ -93,8 +108,9 @@ BOOST_AUTO_TEST_CASE(TestParseSimpleRSS_1_0) {
 	BOOST_CHECK_EQUAL(f.items[0].pubDate, "Tue, 30 Dec 2008 07:20:00 +0000");
 }
 
-BOOST_AUTO_TEST_CASE(TestParseSimpleAtom_1_0) {
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestParseSimpleAtom_1_0, T, backends) {
 	rsspp::parser p;
+	p.set_backend(T::value);
 
 	rsspp::feed f = p.parse_file("data/atom10_1.xml");
 	BOOST_CHECK_EQUAL(f.rss_version, rsspp::ATOM_1_0);
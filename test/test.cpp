@@ -5,6 +5,7 @@
 #include <climits>
 #include <vector>
 #include <string>
+#include <algorithm>
 #include <boost/test/auto_unit_test.hpp>
 
 #include <unistd.h>
@@ -24,6 +25,7 @@
 #include <exceptions.h>
 #include <regexmanager.h>
 #include <htmlrenderer.h>
+#include <failuretracker.h>
 
 #include <stdlib.h>
 
@@ -44,7 +46,7 @@ BOOST_AUTO_TEST_CASE(TestNewsbeuterReload) {
 	BOOST_CHECK_EQUAL(feed->items().size(), 8u);
 
 	rsscache->externalize_rssfeed(feed, false);
-	rsscache->internalize_rssfeed(feed);
+	rsscache->internalize_rssfeed(feed, NULL);
 	BOOST_CHECK_EQUAL(feed->items().size(), 8u);
 
 	BOOST_CHECK_EQUAL(feed->items()[0]->title(), "Teh Saxxi");
@@ -58,7 +60,7 @@ BOOST_AUTO_TEST_CASE(TestNewsbeuterReload) {
 
 	std::tr1::shared_ptr<rss_feed> feed2(new rss_feed(rsscache));
 	feed2->set_rssurl("http://testbed.newsbeuter.org/unit-test/rss.xml");
-	rsscache->internalize_rssfeed(feed2);
+	rsscache->internalize_rssfeed(feed2, NULL);
 
 	BOOST_CHECK_EQUAL(feed2->items().size(), 8u);
 	BOOST_CHECK_EQUAL(feed2->items()[0]->title(), "Another Title");
@@ -412,6 +414,329 @@ BOOST_AUTO_TEST_CASE(TestFilterLanguage) {
 	BOOST_CHECK_EQUAL(m.matches(&tm), false);
 	m.parse("AAAA <= 12345");
 	BOOST_CHECK_EQUAL(m.matches(&tm), true);
+
+	m.parse("AAAA between 1:23456");
+	BOOST_CHECK_EQUAL(m.matches(&tm), true);
+	m.parse("AAAA between 23456:12345");
+	BOOST_CHECK_EQUAL(m.matches(&tm), true);
+	m.parse("AAAA between 1:12344");
+	BOOST_CHECK_EQUAL(m.matches(&tm), false);
+	m.parse("abcd < 1");
+	BOOST_CHECK_EQUAL(m.matches(&tm), true);
+
+	// short-circuit evaluation must skip unavailable attributes
+	m.parse("abcd = \"uiop\" and unknown = \"x\"");
+	BOOST_CHECK_EQUAL(m.matches(&tm), false);
+	m.parse("abcd = \"xyz\" or unknown = \"x\"");
+	BOOST_CHECK_EQUAL(m.matches(&tm), true);
+	m.parse("( abcd = \"uiop\" or AAAA > 1 ) and ( tags # \"xyz\" or abcd =~ \"y\" )");
+	BOOST_CHECK_EQUAL(m.matches(&tm), true);
+	m.parse("abcd = \"xyz\" and unknown = \"x\"");
+	BOOST_CHECK_THROW(m.matches(&tm), matcherexception);
+	m.parse("abcd =~ \"(\"");
+	BOOST_CHECK_THROW(m.matches(&tm), matcherexception);
+}
+
+BOOST_AUTO_TEST_CASE(TestAttributesById) {
+	BOOST_CHECK_EQUAL(matchable::get_attribute_id("title"), ATTR_TITLE);
+	BOOST_CHECK_EQUAL(matchable::get_attribute_id("feedindex"), ATTR_FEEDINDEX);
+	BOOST_CHECK_EQUAL(matchable::get_attribute_id("abcd"), ATTR_UNKNOWN);
+
+	std::tr1::shared_ptr<rss_feed> feed(new rss_feed(NULL));
+	feed->set_title("feed title");
+	std::tr1::shared_ptr<rss_item> item(new rss_item(NULL));
+	item->set_title("item title");
+	item->set_feedptr(feed);
+	BOOST_CHECK_EQUAL(item->get_attribute("title"), "item title");
+	BOOST_CHECK_EQUAL(item->get_attribute("feedtitle"), "feed title");
+	BOOST_CHECK_EQUAL(item->has_attribute("abcd"), false);
+
+	matcher m("title = \"item title\" and feedtitle =~ \"^feed\"");
+	BOOST_CHECK_EQUAL(m.matches(item.get()), true);
+}
+
+BOOST_AUTO_TEST_CASE(TestTypedAttributes) {
+	std::tr1::shared_ptr<rss_feed> feed(new rss_feed(NULL));
+	feed->set_rssurl("http://example.com/feed");
+	feed->set_index(7);
+	std::tr1::shared_ptr<rss_item> item(new rss_item(NULL));
+	item->set_title("42 reasons");
+	item->set_pubDate(time(NULL) - 3 * 86400 - 60);
+	item->set_index(12);
+	item->set_unread_nowrite(true);
+	item->set_feedptr(feed);
+	feed->add_item(item);
+
+	BOOST_CHECK_EQUAL(item->get_attribute_int(ATTR_AGE, "age"), 3);
+	BOOST_CHECK_EQUAL(item->get_attribute_int(ATTR_ARTICLEINDEX, "articleindex"), 12);
+	BOOST_CHECK_EQUAL(item->get_attribute_int(ATTR_TITLE, "title"), 42);
+	BOOST_CHECK_EQUAL(item->get_attribute_int(ATTR_FEEDINDEX, "feedindex"), 7);
+	BOOST_CHECK_EQUAL(item->get_attribute_int(ATTR_UNREAD_COUNT, "unread_count"), 1);
+	BOOST_CHECK_EQUAL(item->get_attribute_time(ATTR_DATE, "date"), item->pubDate_timestamp());
+	BOOST_CHECK_EQUAL(item->get_attribute_time(ATTR_TITLE, "title"), 0);
+
+	std::string buf;
+	BOOST_CHECK(&item->get_attribute_ref(ATTR_TITLE, "title", buf) == &item->title());
+	BOOST_CHECK_EQUAL(item->get_attribute_ref(ATTR_UNREAD, "unread", buf), "yes");
+	BOOST_CHECK_EQUAL(item->get_attribute_ref(ATTR_RSSURL, "rssurl", buf), "http://example.com/feed");
+	BOOST_CHECK_EQUAL(item->get_attribute_ref(ATTR_ARTICLEINDEX, "articleindex", buf), "12");
+
+	matcher m("age between 2:4 and articleindex > 11 and feedindex = \"7\"");
+	BOOST_CHECK_EQUAL(m.matches(item.get()), true);
+}
+
+struct numbermatchable : public matchable {
+	numbermatchable(unsigned int n) : number(n) { }
+	virtual bool has_attribute(const std::string& attribname) {
+		return attribname == "number" || (attribname == "odd" && number % 2 == 1);
+	}
+	virtual std::string get_attribute(const std::string& attribname) {
+		if (attribname == "number")
+			return utils::to_s(number);
+		return "yes";
+	}
+	unsigned int number;
+};
+
+BOOST_AUTO_TEST_CASE(TestMatchesAll) {
+	std::vector<numbermatchable> numbers;
+	for (unsigned int i=0;i<20000;i++) {
+		numbers.push_back(numbermatchable(i));
+	}
+	std::vector<matchable *> items;
+	for (unsigned int i=0;i<numbers.size();i++) {
+		items.push_back(&numbers[i]);
+	}
+
+	matcher m("number =~ \"7$\" or number between 100:199");
+	std::vector<char> results;
+	m.matches_all(items, results);
+	BOOST_REQUIRE_EQUAL(results.size(), items.size());
+	unsigned int mismatches = 0;
+	for (unsigned int i=0;i<items.size();i++) {
+		if ((results[i] != 0) != m.matches(items[i]))
+			++mismatches;
+	}
+	BOOST_CHECK_EQUAL(mismatches, 0u);
+
+	// small inputs are matched by the calling thread
+	std::vector<matchable *> few(items.begin(), items.begin() + 10);
+	m.matches_all(few, results);
+	BOOST_CHECK_EQUAL(results.size(), 10u);
+	BOOST_CHECK_EQUAL(results[7], 1);
+	BOOST_CHECK_EQUAL(results[8], 0);
+
+	m.parse("number > 15000 and odd = \"yes\"");
+	BOOST_CHECK_THROW(m.matches_all(items, results), matcherexception);
+}
+
+struct accesslogmatchable : public matchable {
+	virtual bool has_attribute(const std::string& attribname) {
+		return attribname == "title" || attribname == "content" || attribname == "unread";
+	}
+	virtual std::string get_attribute(const std::string& attribname) {
+		accessed.push_back(attribname);
+		if (attribname == "title")
+			return "x";
+		if (attribname == "content")
+			return "lorem ipsum dolor";
+		return "no";
+	}
+	std::vector<std::string> accessed;
+};
+
+BOOST_AUTO_TEST_CASE(TestFilterReordering) {
+	accesslogmatchable item;
+
+	// the cheap flag check is done first and decides the result
+	matcher m("content =~ \"foo\" and unread = \"yes\"");
+	BOOST_CHECK_EQUAL(m.matches(&item), false);
+	BOOST_REQUIRE_EQUAL(item.accessed.size(), 1u);
+	BOOST_CHECK_EQUAL(item.accessed[0], "unread");
+
+	item.accessed.clear();
+	m.parse("content =~ \"ipsum\" or unread = \"no\"");
+	BOOST_CHECK_EQUAL(m.matches(&item), true);
+	BOOST_REQUIRE_EQUAL(item.accessed.size(), 1u);
+	BOOST_CHECK_EQUAL(item.accessed[0], "unread");
+
+	m.parse("(content =~ \"ipsum\" or title = \"y\") and unread = \"no\"");
+	BOOST_CHECK_EQUAL(m.matches(&item), true);
+	m.parse("content =~ \"ipsum\" and (title = \"y\" or unread = \"yes\")");
+	BOOST_CHECK_EQUAL(m.matches(&item), false);
+
+	// errors are the same as without reordering: the unavailable attribute
+	// isn't looked at, as the regex already decides the result...
+	m.parse("content =~ \"foo\" and abcd = \"x\"");
+	BOOST_CHECK_EQUAL(m.matches(&item), false);
+	m.parse("abcd = \"x\" and content =~ \"foo\"");
+	BOOST_CHECK_THROW(m.matches(&item), matcherexception);
+
+	// ...and an invalid regex is reported even if a cheaper operand would decide the result
+	m.parse("title =~ \"(\" or unread = \"no\"");
+	BOOST_CHECK_THROW(m.matches(&item), matcherexception);
+}
+
+struct textmatchable : public matchable {
+	textmatchable(const std::string& t) : text(t) { }
+	virtual bool has_attribute(const std::string& attribname) {
+		return attribname == "text";
+	}
+	virtual std::string get_attribute(const std::string& /* attribname */) {
+		return text;
+	}
+	std::string text;
+};
+
+BOOST_AUTO_TEST_CASE(TestRegexLiteralPrefilter) {
+	// the matcher skips regexec() if a literal that the regex requires is
+	// missing, which must not change any results
+	const char * regexes[] = { "foo", "FOO", "foo(bar)?baz", "fo+bar", "fo*bar", "ab+?c", "ab{0,2}c", "ab{2}c",
+		"foo|bar", "(foo|bar)baz", "f[o]o", "fo\\.o", "\\<word\\>", "x\\wz", "^start", "end$", "a.c",
+		"mis", "kiss", "[[:digit:]]{3}-42", "caf\xc3\xa9", "word7", "(a)\\1", NULL };
+	const char * texts[] = { "", "foo", "FoO", "foobarbaz", "foobaz", "fbar", "foooBAR", "ac", "abc", "abbc", "abbbc",
+		"bar", "xbarbaz", "fo.o", "foxo", "a word here", "xyz", "x_z", "start end", "abc", "MIS", "mi\xc5\xbf",
+		"K\xc4\xb1ss", "123-42", "CAF\xc3\xa9", "word70", "aa", "1abc", "abc\\", "ab", NULL };
+
+	unsigned int mismatches = 0;
+	for (unsigned int i=0;regexes[i];i++) {
+		regex_t rx;
+		BOOST_REQUIRE_EQUAL(regcomp(&rx, regexes[i], REG_EXTENDED | REG_ICASE | REG_NOSUB), 0);
+		matcher m(utils::strprintf("text =~ \"%s\"", regexes[i]));
+		for (unsigned int j=0;texts[j];j++) {
+			textmatchable item(texts[j]);
+			bool expected = regexec(&rx, texts[j], 0, NULL, 0) == 0;
+			if (m.matches(&item) != expected) {
+				BOOST_TEST_MESSAGE(utils::strprintf("`%s' =~ `%s' isn't %d", texts[j], regexes[i], expected));
+				mismatches++;
+			}
+		}
+		regfree(&rx);
+	}
+	BOOST_CHECK_EQUAL(mismatches, 0u);
+}
+
+struct generationmatchable : public accesslogmatchable {
+	generationmatchable() : generation(1) { }
+	virtual bool has_attribute(const std::string& attribname) {
+		return attribname == "age" || accesslogmatchable::has_attribute(attribname);
+	}
+	virtual std::string get_attribute(const std::string& attribname) {
+		if (attribname == "age") {
+			accessed.push_back(attribname);
+			return "0";
+		}
+		return accesslogmatchable::get_attribute(attribname);
+	}
+	virtual unsigned long attribute_generation() {
+		return generation;
+	}
+	unsigned long generation;
+};
+
+BOOST_AUTO_TEST_CASE(TestMatcherMemo) {
+	generationmatchable item;
+	matcher m("title = \"x\"");
+
+	// the result for an unchanged item is reused...
+	BOOST_CHECK_EQUAL(m.matches(&item), true);
+	BOOST_CHECK_EQUAL(item.accessed.size(), 1u);
+	BOOST_CHECK_EQUAL(m.matches(&item), true);
+	BOOST_CHECK_EQUAL(item.accessed.size(), 1u);
+
+	std::vector<matchable *> items(1, &item);
+	std::vector<char> result;
+	m.matches_all(items, result);
+	BOOST_CHECK_EQUAL(result[0], 1);
+	BOOST_CHECK_EQUAL(item.accessed.size(), 1u);
+
+	// ...but not after it changed, or for another expression
+	item.generation = 2;
+	BOOST_CHECK_EQUAL(m.matches(&item), true);
+	BOOST_CHECK_EQUAL(item.accessed.size(), 2u);
+	m.parse("title = \"y\"");
+	BOOST_CHECK_EQUAL(m.matches(&item), false);
+	BOOST_CHECK_EQUAL(item.accessed.size(), 3u);
+
+	// items without a generation are always matched
+	accesslogmatchable plain;
+	BOOST_CHECK_EQUAL(m.matches(&plain), false);
+	BOOST_CHECK_EQUAL(m.matches(&plain), false);
+	BOOST_CHECK_EQUAL(plain.accessed.size(), 2u);
+
+	// rss_items get a new generation whenever they or their feed change
+	std::tr1::shared_ptr<rss_feed> feed(new rss_feed(NULL));
+	std::tr1::shared_ptr<rss_item> rssitem(new rss_item(NULL));
+	rssitem->set_feedptr(feed);
+	unsigned long generation = rssitem->attribute_generation();
+	BOOST_CHECK(generation != 0);
+	rssitem->set_title("title");
+	BOOST_CHECK(rssitem->attribute_generation() != generation);
+	generation = rssitem->attribute_generation();
+	rssitem->set_flags("s");
+	BOOST_CHECK(rssitem->attribute_generation() != generation);
+	generation = rssitem->attribute_generation();
+	feed->set_title("feed");
+	BOOST_CHECK(rssitem->attribute_generation() != generation);
+
+	m.parse("feedtitle = \"feed\"");
+	BOOST_CHECK_EQUAL(m.matches(rssitem.get()), true);
+	feed->set_title("other feed");
+	BOOST_CHECK_EQUAL(m.matches(rssitem.get()), false);
+
+	// the age of an item changes without the item changing
+	m.parse("age < 1");
+	BOOST_CHECK_EQUAL(m.matches(&item), true);
+	BOOST_CHECK_EQUAL(m.matches(&item), true);
+	BOOST_CHECK_EQUAL(item.accessed.size(), 5u);
+}
+
+BOOST_AUTO_TEST_CASE(TestContainsOperator) {
+	// "#" looks for whole space-separated words, like comparing the tokens
+	const char * words[] = { "foo", "bar", "fo", "oo", "foo bar", "a", NULL };
+	const char * texts[] = { "", "foo", "foobar", "foo bar", " foo ", "barfoo foo", "xfoo foox", "fo foo",
+		"a  b", "bar  ", "foofoo foo", NULL };
+	unsigned int mismatches = 0;
+	for (unsigned int i=0;words[i];i++) {
+		matcher m(utils::strprintf("text # \"%s\"", words[i]));
+		for (unsigned int j=0;texts[j];j++) {
+			textmatchable item(texts[j]);
+			std::vector<std::string> tokens = utils::tokenize(texts[j], " ");
+			bool expected = std::find(tokens.begin(), tokens.end(), words[i]) != tokens.end();
+			if (m.matches(&item) != expected) {
+				BOOST_TEST_MESSAGE(utils::strprintf("`%s' # `%s' isn't %d", texts[j], words[i], expected));
+				mismatches++;
+			}
+		}
+	}
+	BOOST_CHECK_EQUAL(mismatches, 0u);
+
+	// tags are looked up in the feed's set of tags, which leaves out the
+	// hidden ones (starting with "~") and follows changes to the tags
+	std::tr1::shared_ptr<rss_feed> feed(new rss_feed(NULL));
+	std::tr1::shared_ptr<rss_item> item(new rss_item(NULL));
+	item->set_feedptr(feed);
+	std::vector<std::string> tags;
+	tags.push_back("news");
+	tags.push_back("two words");
+	tags.push_back("~hidden");
+	feed->set_tags(tags);
+
+	matcher m("tags # \"news\"");
+	BOOST_CHECK_EQUAL(m.matches(feed.get()), true);
+	BOOST_CHECK_EQUAL(m.matches(item.get()), true);
+	m.parse("tags # \"words\" and tags !# \"~hidden\" and tags !# \"hidden\"");
+	BOOST_CHECK_EQUAL(m.matches(item.get()), true);
+	m.parse("tags # \"two words\"");
+	BOOST_CHECK_EQUAL(m.matches(item.get()), false);
+
+	tags.clear();
+	tags.push_back("linux");
+	feed->set_tags(tags);
+	m.parse("tags # \"news\"");
+	BOOST_CHECK_EQUAL(m.matches(item.get()), false);
+	m.parse("tags # \"linux\"");
+	BOOST_CHECK_EQUAL(m.matches(item.get()), true);
 }
 
 BOOST_AUTO_TEST_CASE(TestFilterLanguageMemMgmt) {
@@ -518,6 +843,54 @@ BOOST_AUTO_TEST_CASE(TestMiscUtilsFunctions) {
 	argv[3] = NULL;
 	BOOST_CHECK_EQUAL(utils::run_program(argv, ""), "hello world");
 
+	// more input than fits into a pipe must not dead-lock
+	std::string large_input(1024 * 1024, 'x');
+	argv[0] = "cat";
+	argv[1] = NULL;
+	BOOST_CHECK_EQUAL(utils::run_program(argv, large_input).length(), large_input.length());
+
+	bool killed = true;
+	argv[0] = "echo";
+	argv[1] = "foo";
+	argv[2] = NULL;
+	BOOST_CHECK_EQUAL(utils::run_program(argv, "", 1, NULL, &killed), "foo\n");
+	BOOST_CHECK(!killed);
+
+	argv[0] = "sleep";
+	argv[1] = "10";
+	argv[2] = NULL;
+	time_t start = time(NULL);
+	BOOST_CHECK_EQUAL(utils::run_program(argv, "", 1, NULL, &killed), "");
+	BOOST_CHECK(killed);
+	BOOST_CHECK(time(NULL) - start < 5);
+
+	// the output up to the timeout is returned, but the kill is reported
+	argv[0] = "/bin/sh";
+	argv[1] = "-c";
+	argv[2] = "echo foo; sleep 10; echo bar";
+	argv[3] = NULL;
+	killed = false;
+	BOOST_CHECK_EQUAL(utils::run_program(argv, "", 1, NULL, &killed), "foo\n");
+	BOOST_CHECK(killed);
+
+	// a timeout kills everything the program started, not only the shell
+	::unlink("test-survivor");
+	argv[2] = "echo foo; (sleep 2; touch test-survivor) | cat";
+	BOOST_CHECK_EQUAL(utils::run_program(argv, "", 1), "foo\n");
+	::sleep(3);
+	BOOST_CHECK(::access("test-survivor", F_OK) != 0);
+	::unlink("test-survivor");
+
+	// a cancelled token kills the program as well
+	cancel_token cancel;
+	cancel.cancel();
+	argv[2] = "sleep 10 | cat";
+	killed = false;
+	start = time(NULL);
+	BOOST_CHECK_EQUAL(utils::run_program(argv, "", 0, &cancel, &killed), "");
+	BOOST_CHECK(killed);
+	BOOST_CHECK(time(NULL) - start < 5);
+
 	BOOST_CHECK_EQUAL(utils::replace_all("aaa", "a", "b"), "bbb");
 	BOOST_CHECK_EQUAL(utils::replace_all("aaa", "aa", "ba"), "baa");
 	BOOST_CHECK_EQUAL(utils::replace_all("aaaaaa", "aa", "ba"), "bababa");
@@ -628,6 +1001,51 @@ BOOST_AUTO_TEST_CASE(TestRegexManager) {
 	rxman.quote_and_highlight(str, "feedlist");
 	BOOST_CHECK_EQUAL(str, "a<b>");
 }
+
+static void add_highlight(regexmanager& rxman, const std::string& location, const std::string& rx) {
+	std::vector<std::string> params;
+	params.push_back(location);
+	params.push_back(rx);
+	params.push_back("red");
+	params.push_back("default");
+	rxman.handle_action("highlight", params);
+}
+
+BOOST_AUTO_TEST_CASE(TestRegexManagerManyRules) {
+	regexmanager rxman;
+	for (unsigned int i=0;i<50;i++) {
+		add_highlight(rxman, "articlelist", utils::strprintf("keyword%u", i));
+	}
+	add_highlight(rxman, "articlelist", "[0-9]+ comments");
+	add_highlight(rxman, "articlelist", "Linux|BSD");
+	add_highlight(rxman, "articlelist", "x*");
+
+	std::string str = "news about keyword7 and KEYWORD42";
+	rxman.quote_and_highlight(str, "articlelist");
+	BOOST_CHECK_EQUAL(str, "news about <7>keyword7</> and <42>KEYWORD42</>");
+
+	// a later rule takes precedence where matches overlap
+	str = "<60>keyword3 has 12 comments</>";
+	rxman.quote_and_highlight(str, "articlelist");
+	BOOST_CHECK_EQUAL(str, "<60><3>keyword3</><60> has <50>12 comments</><60></>");
+
+	str = "FreeBSD and Linux";
+	rxman.quote_and_highlight(str, "articlelist");
+	BOOST_CHECK_EQUAL(str, "Free<51>BSD</> and <51>Linu</><52>x</>");
+
+	str = "nothing to see here";
+	rxman.quote_and_highlight(str, "articlelist");
+	BOOST_CHECK_EQUAL(str, "nothing to see here");
+
+	add_highlight(rxman, "articlelist", "see");
+	str = "nothing to see here";
+	rxman.quote_and_highlight(str, "articlelist");
+	BOOST_CHECK_EQUAL(str, "nothing to <53>see</> here");
+	rxman.remove_last_regex("articlelist");
+	str = "nothing to see here";
+	rxman.quote_and_highlight(str, "articlelist");
+	BOOST_CHECK_EQUAL(str, "nothing to see here");
+}
 BOOST_AUTO_TEST_CASE(TestHtmlRenderer) {
 	htmlrenderer rnd(100);
 
@@ -793,3 +1211,400 @@ BOOST_AUTO_TEST_CASE(TestUtilsFunction_trim) {
 	utils::trim_end(str);
 	BOOST_CHECK_EQUAL(str, "quux");
 }
+
+BOOST_AUTO_TEST_CASE(TestUtilsFunction_parse_date) {
+	const char * rfc822[] = {
+		"Tue, 30 Dec 2008 12:34:56 +0100",
+		"Tue, 30 Dec 2008 12:34:56 -0830",
+		"Tue, 30 Dec 2008 12:34:56 GMT",
+		"Tue, 30 Dec 2008 12:34:56 UTC",
+		"Tue, 30 Dec 2008 12:34:56 EST",
+		"Tue, 30 Dec 2008 12:34:56 PDT",
+		"Tue, 30 Dec 2008 12:34 +0000",
+		"Tue,  3 Mar 2009 01:02:03 +0000",
+		"tue, 3 mar 2009 01:02:03 GMT",
+		"Thu, 29 Feb 2024 23:59:59 +0000",
+		"01 Jan 1970 00:00:00 GMT",
+		"Sat, 01 Jan 2000 00:00:00",
+	};
+	for (unsigned int i=0;i<sizeof(rfc822)/sizeof(rfc822[0]);i++) {
+		time_t t = 0;
+		BOOST_CHECK(utils::parse_date(rfc822[i], t));
+		BOOST_CHECK_EQUAL(t, curl_getdate(rfc822[i], NULL));
+	}
+
+	time_t t;
+	BOOST_CHECK(utils::parse_date("2008-12-30T12:34:56Z", t));
+	BOOST_CHECK_EQUAL(t, 1230640496);
+	BOOST_CHECK(utils::parse_date("2008-12-30T13:34:56+01:00", t));
+	BOOST_CHECK_EQUAL(t, 1230640496);
+	BOOST_CHECK(utils::parse_date("2008-12-30T04:04:56.123-08:30", t));
+	BOOST_CHECK_EQUAL(t, 1230640496);
+	BOOST_CHECK(utils::parse_date("2008-12-30T12:34:56", t));
+	BOOST_CHECK_EQUAL(t, 1230640496);
+
+	// anything else is left to curl_getdate
+	BOOST_CHECK(!utils::parse_date("", t));
+	BOOST_CHECK(!utils::parse_date("2008-12-30", t));
+	BOOST_CHECK(!utils::parse_date("Tue, 30 Dec 08 12:34:56 GMT", t));
+	BOOST_CHECK(!utils::parse_date("Tue, 30 Dez 2008 12:34:56 GMT", t));
+	BOOST_CHECK(!utils::parse_date("Tue, 30 Dec 2008 12:34:56 CEST", t));
+	BOOST_CHECK(!utils::parse_date("Tue, 30 Dec 2008 25:34:56 GMT", t));
+	BOOST_CHECK(!utils::parse_date("30 Dec 2008", t));
+}
+
+BOOST_AUTO_TEST_CASE(TestRssItemTakeSetters) {
+	rss_item item(NULL);
+	std::string title = "  a title\n";
+	std::string desc = "<p>a description</p>";
+	std::string guid = "a guid";
+
+	item.take_title(title);
+	item.take_description(desc);
+	item.take_guid(guid);
+
+	BOOST_CHECK_EQUAL(item.title_raw(), "a title");
+	BOOST_CHECK_EQUAL(item.description_raw(), "<p>a description</p>");
+	BOOST_CHECK_EQUAL(item.guid(), "a guid");
+	BOOST_CHECK_EQUAL(desc, "");
+	BOOST_CHECK_EQUAL(guid, "");
+}
+
+BOOST_AUTO_TEST_CASE(TestUtilsFunction_convert_text) {
+	BOOST_CHECK_EQUAL(utils::convert_text("plain ascii", "ISO-8859-1", "UTF-8"), "plain ascii");
+	BOOST_CHECK_EQUAL(utils::convert_text("gr\xc3\xbc\xc3\x9f" "e", "ISO-8859-1", "UTF-8"), "gr\xfc\xdf" "e");
+	BOOST_CHECK_EQUAL(utils::convert_text("gr\xfc\xdf" "e", "UTF-8", "ISO-8859-1"), "gr\xc3\xbc\xc3\x9f" "e");
+	// the cached converter must not carry anything over from the last call
+	BOOST_CHECK_EQUAL(utils::convert_text("gr\xc3\xbc\xc3\x9f" "e", "ISO-8859-1", "UTF-8"), "gr\xfc\xdf" "e");
+	BOOST_CHECK_EQUAL(utils::convert_text("a\xff" "b", "ISO-8859-1", "UTF-8"), "a?b");
+
+	std::string longtext;
+	for (unsigned int i=0;i<5000;i++)
+		longtext.append("\xc3\xa4");
+	BOOST_CHECK_EQUAL(utils::convert_text(longtext, "ISO-8859-1", "UTF-8"), std::string(5000, '\xe4'));
+	BOOST_CHECK_EQUAL(utils::convert_text("\xe4", "UTF-8", "NO-SUCH-ENCODING"), "");
+}
+
+BOOST_AUTO_TEST_CASE(TestSortItemsByTitle) {
+	rss_feed feed(NULL);
+	const char * titles[] = { "banana", "Cherry", "apple", "Apricot" };
+	for (unsigned int i=0;i<4;i++) {
+		std::tr1::shared_ptr<rss_item> item(new rss_item(NULL));
+		item->set_title(titles[i]);
+		feed.add_item(item);
+	}
+
+	feed.sort("title");
+	BOOST_CHECK_EQUAL(feed.items()[0]->title(), "apple");
+	BOOST_CHECK_EQUAL(feed.items()[1]->title(), "Apricot");
+	BOOST_CHECK_EQUAL(feed.items()[2]->title(), "banana");
+	BOOST_CHECK_EQUAL(feed.items()[3]->title(), "Cherry");
+
+	// changing the title must update the sort key as well
+	feed.items()[0]->set_title("Zucchini");
+	feed.sort("title-desc");
+	BOOST_CHECK_EQUAL(feed.items()[0]->title(), "Zucchini");
+	BOOST_CHECK_EQUAL(feed.items()[0]->title_sortkey(), "zucchini");
+	BOOST_CHECK_EQUAL(feed.items()[1]->title(), "Cherry");
+}
+
+BOOST_AUTO_TEST_CASE(TestGetItemByGuid) {
+	rss_feed feed(NULL);
+	for (unsigned int i=0;i<5;i++) {
+		std::tr1::shared_ptr<rss_item> item(new rss_item(NULL));
+		item->set_guid(utils::strprintf("guid-%u", i));
+		feed.add_item(item);
+	}
+	std::tr1::shared_ptr<rss_item> dup(new rss_item(NULL));
+	dup->set_guid("guid-2");
+	feed.add_item(dup);
+
+	BOOST_CHECK(feed.get_item_by_guid("guid-0") == feed.items()[0]);
+	BOOST_CHECK(feed.get_item_by_guid("guid-4") == feed.items()[4]);
+	BOOST_CHECK(!feed.get_item_by_guid("no-such-guid"));
+
+	// the first item with a guid is found; if it's removed, the next one is
+	BOOST_CHECK(feed.get_item_by_guid("guid-2") == feed.items()[2]);
+	feed.erase_item(feed.items().begin() + 2);
+	BOOST_CHECK(feed.get_item_by_guid("guid-2") == dup);
+
+	feed.erase_items(feed.items().begin(), feed.items().begin() + 2);
+	BOOST_CHECK(!feed.get_item_by_guid("guid-0"));
+	BOOST_CHECK(!feed.get_item_by_guid("guid-1"));
+	BOOST_CHECK(feed.get_item_by_guid("guid-3") == feed.items()[0]);
+
+	std::vector<std::tr1::shared_ptr<rss_item> > items;
+	items.push_back(dup);
+	feed.set_items(items);
+	BOOST_CHECK(!feed.get_item_by_guid("guid-3"));
+	BOOST_CHECK(feed.get_item_by_guid("guid-2") == dup);
+
+	feed.clear_items();
+	BOOST_CHECK(!feed.get_item_by_guid("guid-2"));
+}
+
+BOOST_AUTO_TEST_CASE(TestUnreadItemCount) {
+	std::tr1::shared_ptr<rss_feed> feed(new rss_feed(NULL));
+	std::tr1::shared_ptr<rss_feed> queryfeed(new rss_feed(NULL));
+	for (unsigned int i=0;i<4;i++) {
+		std::tr1::shared_ptr<rss_item> item(new rss_item(NULL));
+		item->set_guid(utils::strprintf("guid-%u", i));
+		item->set_unread_nowrite(i % 2 == 0);
+		feed->add_item(item);
+		queryfeed->add_item(item);
+	}
+	BOOST_CHECK_EQUAL(feed->unread_item_count(), 2u);
+	BOOST_CHECK_EQUAL(queryfeed->unread_item_count(), 2u);
+
+	// changes to an item are seen by all feeds that contain it
+	feed->items()[0]->set_unread(false);
+	feed->items()[1]->set_unread_nowrite(true);
+	feed->items()[3]->set_unread_nowrite_notify(true, false);
+	BOOST_CHECK_EQUAL(feed->unread_item_count(), 3u);
+	BOOST_CHECK_EQUAL(queryfeed->unread_item_count(), 3u);
+
+	queryfeed->erase_item(queryfeed->items().begin() + 1);
+	BOOST_CHECK_EQUAL(queryfeed->unread_item_count(), 2u);
+	feed->items()[1]->set_unread(false);
+	BOOST_CHECK_EQUAL(feed->unread_item_count(), 2u);
+	BOOST_CHECK_EQUAL(queryfeed->unread_item_count(), 2u);
+
+	// an item that outlives a feed must not update it anymore
+	std::tr1::shared_ptr<rss_item> item = feed->items()[2];
+	queryfeed.reset();
+	item->set_unread(false);
+	BOOST_CHECK_EQUAL(feed->unread_item_count(), 1u);
+
+	feed->clear_items();
+	BOOST_CHECK_EQUAL(feed->unread_item_count(), 0u);
+}
+
+static std::tr1::shared_ptr<rss_feed> make_query_source(const std::string& url, const char ** titles) {
+	std::tr1::shared_ptr<rss_feed> feed(new rss_feed(NULL));
+	feed->set_rssurl(url);
+	for (unsigned int i=0;titles[i];i++) {
+		std::tr1::shared_ptr<rss_item> item(new rss_item(NULL));
+		item->set_title(titles[i]);
+		item->set_guid(url + titles[i]);
+		item->set_pubDate(1000 + i);
+		item->set_unread_nowrite(true);
+		item->set_feedptr(feed);
+		feed->add_item(item);
+	}
+	return feed;
+}
+
+BOOST_AUTO_TEST_CASE(TestQueryFeedUpdate) {
+	const char * titles1[] = { "delta", "alpha", NULL };
+	const char * titles2[] = { "charlie", "bravo", "echo", NULL };
+	const char * titles3[] = { "foxtrot", "beta", NULL };
+	std::vector<std::tr1::shared_ptr<rss_feed> > feeds;
+	feeds.push_back(make_query_source("http://one/", titles1));
+	feeds.push_back(make_query_source("http://two/", titles2));
+
+	std::tr1::shared_ptr<rss_feed> query(new rss_feed(NULL));
+	query->set_rssurl("query:unread:unread = \"yes\"");
+	feeds.push_back(query);
+
+	query->update_items(feeds);
+	query->sort("title");
+	BOOST_REQUIRE_EQUAL(query->items().size(), 5u);
+	BOOST_CHECK_EQUAL(query->items()[0]->title(), "alpha");
+	BOOST_CHECK_EQUAL(query->items()[4]->title(), "echo");
+
+	// nothing changed, so nothing is matched again
+	unsigned long gen = query->generation();
+	query->update_items(feeds);
+	BOOST_CHECK_EQUAL(query->generation(), gen);
+	BOOST_CHECK_EQUAL(query->items().size(), 5u);
+
+	// an item that was read drops out, new matches are merged in title order
+	feeds[1]->items()[0]->set_unread_nowrite(false);
+	feeds[0] = make_query_source("http://one/", titles3);
+	query->update_items(feeds);
+	query->sort("title");
+	BOOST_REQUIRE_EQUAL(query->items().size(), 4u);
+	BOOST_CHECK_EQUAL(query->items()[0]->title(), "beta");
+	BOOST_CHECK_EQUAL(query->items()[1]->title(), "bravo");
+	BOOST_CHECK_EQUAL(query->items()[2]->title(), "echo");
+	BOOST_CHECK_EQUAL(query->items()[3]->title(), "foxtrot");
+	BOOST_CHECK_EQUAL(query->unread_item_count(), 4u);
+	BOOST_CHECK(!query->get_item_by_guid("http://one/alpha"));
+
+	// a feed that disappears takes its items with it
+	feeds.erase(feeds.begin());
+	query->update_items(feeds);
+	BOOST_CHECK_EQUAL(query->items().size(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(TestPurgeDeletedItems) {
+	std::tr1::shared_ptr<rss_feed> feed(new rss_feed(NULL));
+	for (unsigned int i=0;i<6;i++) {
+		std::tr1::shared_ptr<rss_item> item(new rss_item(NULL));
+		item->set_guid(utils::strprintf("guid-%u", i));
+		item->set_unread_nowrite(true);
+		item->set_deleted(i % 3 != 2);
+		feed->add_item(item);
+	}
+	BOOST_CHECK_EQUAL(feed->unread_item_count(), 6u);
+
+	feed->purge_deleted_items();
+	BOOST_REQUIRE_EQUAL(feed->items().size(), 2u);
+	BOOST_CHECK_EQUAL(feed->items()[0]->guid(), "guid-2");
+	BOOST_CHECK_EQUAL(feed->items()[1]->guid(), "guid-5");
+	BOOST_CHECK_EQUAL(feed->unread_item_count(), 2u);
+	BOOST_CHECK(!feed->get_item_by_guid("guid-0"));
+	BOOST_CHECK_EQUAL(feed->get_item_by_guid("guid-5")->guid(), "guid-5");
+
+	feed->purge_deleted_items();
+	BOOST_CHECK_EQUAL(feed->items().size(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(TestIgnoreArticle) {
+	rss_ignores ign;
+	std::vector<std::string> params;
+	params.push_back("http://a.example.com/feed");
+	params.push_back("title = \"spam\"");
+	ign.handle_action("ignore-article", params);
+	params[0] = "*";
+	params[1] = "author = \"troll\"";
+	ign.handle_action("ignore-article", params);
+	params[0] = "http://b.example.com/feed";
+	params[1] = "title =~ \"^ad\"";
+	ign.handle_action("ignore-article", params);
+
+	rss_item item(NULL);
+	item.set_feedurl("http://a.example.com/feed");
+	item.set_title("spam");
+	BOOST_CHECK(ign.matches(&item));
+	item.set_feedurl("http://b.example.com/feed");
+	BOOST_CHECK(!ign.matches(&item));
+	item.set_title("advertisement");
+	BOOST_CHECK(ign.matches(&item));
+	item.set_feedurl("http://c.example.com/feed");
+	BOOST_CHECK(!ign.matches(&item));
+	item.set_author("troll");
+	BOOST_CHECK(ign.matches(&item));
+
+	// rules are applied in the order of the configuration
+	params[0] = "http://c.example.com/feed";
+	params[1] = "feedtitle = \"foo\"";
+	ign.handle_action("ignore-article", params);
+	BOOST_CHECK(ign.matches(&item));
+	item.set_author("someone");
+	BOOST_CHECK_THROW(ign.matches(&item), matcherexception);
+
+	std::vector<std::string> config;
+	ign.dump_config(config);
+	BOOST_REQUIRE_EQUAL(config.size(), 4u);
+	BOOST_CHECK_EQUAL(config[1], "ignore-article * \"author = \\\"troll\\\"\"");
+	BOOST_CHECK_EQUAL(config[3], "ignore-article \"http://c.example.com/feed\" \"feedtitle = \\\"foo\\\"\"");
+}
+
+struct clocked_failure_tracker : public failure_tracker {
+	clocked_failure_tracker(cache * c) : failure_tracker(c), now(1000000) { }
+	virtual time_t current_time() { return now; }
+	time_t now;
+};
+
+BOOST_AUTO_TEST_CASE(TestFailureTracker) {
+	configcontainer cfg;
+	cache * rsscache = new cache("test-failures.db", &cfg);
+	clocked_failure_tracker ft(rsscache);
+
+	BOOST_CHECK(failure_tracker::is_host_error(CURLE_COULDNT_RESOLVE_HOST));
+	BOOST_CHECK(failure_tracker::is_host_error(CURLE_COULDNT_CONNECT));
+	BOOST_CHECK(failure_tracker::is_host_error(CURLE_OPERATION_TIMEDOUT));
+	BOOST_CHECK(!failure_tracker::is_host_error(CURLE_HTTP_RETURNED_ERROR));
+	BOOST_CHECK(!failure_tracker::is_host_error(CURLE_ABORTED_BY_CALLBACK));
+
+	// failures of a host that answers never open its circuit
+	for (unsigned int i=0;i<10;i++) {
+		std::string url = utils::strprintf("http://up.example.com/%u", i);
+		BOOST_CHECK(ft.may_reload(url));
+		ft.record_failure(url, false);
+	}
+	BOOST_CHECK(ft.may_reload("http://up.example.com/new"));
+
+	// the third failure in a row opens the circuit. Downloads that were
+	// already running when it opened don't trip it again: the first probe
+	// is let through after the shortest possible delay (10 minutes + 25%)
+	for (unsigned int i=0;i<5;i++) {
+		ft.record_failure(utils::strprintf("http://down.example.com/%u", i), true);
+	}
+	BOOST_CHECK(!ft.may_reload("http://down.example.com/a"));
+	ft.now += 751;
+	BOOST_CHECK(ft.may_reload("http://down.example.com/probe"));
+	// only one probe at a time
+	BOOST_CHECK(!ft.may_reload("http://down.example.com/a"));
+
+	// a failure of another feed doesn't count as the probe's result...
+	ft.record_failure("http://down.example.com/0", true);
+	BOOST_CHECK(!ft.may_reload("http://down.example.com/a"));
+	// ...but a failed probe keeps the circuit open for twice as long
+	ft.record_failure("http://down.example.com/probe", true);
+	ft.now += 751;
+	BOOST_CHECK(!ft.may_reload("http://down.example.com/a"));
+	ft.now += 750;
+	BOOST_CHECK(ft.may_reload("http://down.example.com/probe2"));
+
+	// a dropped probe makes room for another one
+	BOOST_CHECK(!ft.may_reload("http://down.example.com/a"));
+	ft.record_dropped("http://down.example.com/probe2");
+	BOOST_CHECK(ft.may_reload("http://down.example.com/probe3"));
+
+	// a successful probe closes the circuit
+	ft.record_success("http://down.example.com/probe3");
+	BOOST_CHECK(ft.may_reload("http://down.example.com/a"));
+	BOOST_CHECK(ft.may_reload("http://down.example.com/b"));
+
+	// every feed backs off on its own, whatever the reason of the failure
+	std::tr1::shared_ptr<rss_feed> feed(new rss_feed(rsscache));
+	feed->set_rssurl("http://up.example.com/feed");
+	rsscache->externalize_rssfeed(feed, false);
+	BOOST_CHECK(ft.may_reload(feed->rssurl()));
+	ft.record_failure(feed->rssurl(), false);
+	BOOST_CHECK(!ft.may_reload(feed->rssurl()));
+	BOOST_CHECK(ft.may_reload("http://up.example.com/other"));
+	ft.now += 376;
+	BOOST_CHECK(ft.may_reload(feed->rssurl()));
+	ft.record_success(feed->rssurl());
+	ft.record_failure(feed->rssurl(), false);
+	ft.now += 376;
+	BOOST_CHECK(ft.may_reload(feed->rssurl()));
+
+	delete rsscache;
+	::unlink("test-failures.db");
+}
+
+BOOST_AUTO_TEST_CASE(TestPluginTimeout) {
+	configcontainer cfg;
+	cfg.set_configvalue("plugin-timeout", "1");
+	cache * rsscache = new cache("test-failures.db", &cfg);
+	clocked_failure_tracker ft(rsscache);
+
+	// the output up to the timeout is a well-formed feed, but it is incomplete
+	std::tr1::shared_ptr<rss_feed> feed(new rss_feed(rsscache));
+	feed->set_rssurl("exec:echo '<rss version=\"2.0\"><channel><title>t</title></channel></rss>'; sleep 10");
+	rsscache->externalize_rssfeed(feed, false);
+
+	rss_parser parser(feed->rssurl().c_str(), rsscache, &cfg, NULL);
+	time_t start = time(NULL);
+	bool failed = false;
+	try {
+		parser.parse();
+	} catch (const std::string& errmsg) {
+		BOOST_CHECK_EQUAL(errmsg, "plugin timed out");
+		failed = true;
+	}
+	BOOST_CHECK(failed);
+	BOOST_CHECK(time(NULL) - start < 5);
+
+	// which the reload records like every other failure, so the feed backs off
+	if (failed)
+		ft.record_failure(feed->rssurl(), false);
+	BOOST_CHECK(!ft.may_reload(feed->rssurl()));
+
+	delete rsscache;
+	::unlink("test-failures.db");
+}